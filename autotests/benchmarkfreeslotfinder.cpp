@@ -0,0 +1,78 @@
+/*
+  This file is part of the kcalcore library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with this library; see the file COPYING.LIB.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+#include "benchmarkfreeslotfinder.h"
+#include "freeslotfinder.h"
+
+#include <QRandomGenerator>
+#include <QTest>
+
+QTEST_MAIN(FreeSlotFinderBenchmark)
+
+using namespace KCalendarCore;
+
+static const int attendeeCount = 1000;
+static const int dayCount = 28;
+static const int periodsPerDay = 6;
+static const QDateTime windowStart(QDate(2019, 6, 3), QTime(0, 0, 0), Qt::UTC);
+
+void FreeSlotFinderBenchmark::initTestCase()
+{
+    QRandomGenerator generator(42);
+    mFreeBusyList.reserve(attendeeCount);
+    for (int i = 0; i < attendeeCount; ++i) {
+        FreeBusyPeriod::List periods;
+        periods.reserve(dayCount * periodsPerDay);
+        for (int day = 0; day < dayCount; ++day) {
+            const QDateTime dayStart = windowStart.addDays(day);
+            for (int j = 0; j < periodsPerDay; ++j) {
+                // Half hour steps between 08:00 and 18:00, lasting up to two hours
+                const QDateTime start = dayStart.addSecs((16 + generator.bounded(20)) * 1800);
+                periods << FreeBusyPeriod(start, start.addSecs((1 + generator.bounded(4)) * 1800));
+            }
+        }
+        FreeBusy::Ptr freeBusy(new FreeBusy(windowStart, windowStart.addDays(dayCount)));
+        freeBusy->addPeriods(periods);
+        mFreeBusyList << freeBusy;
+    }
+}
+
+void FreeSlotFinderBenchmark::benchmarkFindSlots()
+{
+    FreeSlotFinder finder(mFreeBusyList);
+    finder.setTimeZone(QTimeZone::utc());
+    Period::List freeSlots;
+    QBENCHMARK {
+        freeSlots = finder.findSlots(windowStart, windowStart.addDays(dayCount), Duration(3600), 10);
+    }
+    QCOMPARE(freeSlots.count(), 10);
+}
+
+void FreeSlotFinderBenchmark::benchmarkFindSlotsWorkingHours()
+{
+    // With this many attendees there is hardly any common free time within
+    // working hours, so every busy period is visited.
+    FreeSlotFinder finder(mFreeBusyList);
+    finder.setTimeZone(QTimeZone::utc());
+    finder.setWorkingHours(QTime(9, 0), QTime(17, 0));
+    QBENCHMARK {
+        const Period::List freeSlots = finder.findSlots(windowStart, windowStart.addDays(dayCount), Duration(3600), 10);
+        Q_UNUSED(freeSlots);
+    }
+}
@@ -0,0 +1,103 @@
+/*
+  This file is part of the kcalcore library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with this library; see the file COPYING.LIB.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+#include "benchmarkicalformat.h"
+#include "icalformat.h"
+#include "memorycalendar.h"
+
+#include <QFile>
+#include <QTest>
+#include <QTimeZone>
+
+QTEST_MAIN(ICalFormatBenchmark)
+
+using namespace KCalendarCore;
+
+static const int eventCount = 100000;
+
+// Half of the time zones are referred to by IANA id, the other half are
+// custom VTIMEZONE definitions as written by Outlook and Exchange
+static const int ianaZoneCount = 25;
+static const int customZoneCount = 25;
+
+void ICalFormatBenchmark::initTestCase()
+{
+    QVERIFY(mDir.isValid());
+    mFileName = mDir.filePath(QStringLiteral("timezones.ics"));
+
+    QList<QByteArray> tzids;
+    const QList<QByteArray> available = QTimeZone::availableTimeZoneIds();
+    for (const QByteArray &id : available) {
+        if (tzids.count() < ianaZoneCount && id.contains('/')) {
+            tzids.append(id);
+        }
+    }
+    QCOMPARE(tzids.count(), ianaZoneCount);
+
+    QFile file(mFileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("BEGIN:VCALENDAR\r\n"
+               "PRODID:-//K Desktop Environment//NONSGML libkcal 4.3//EN\r\n"
+               "VERSION:2.0\r\n");
+    for (int i = 0; i < customZoneCount; ++i) {
+        const QByteArray tzid = "Custom Standard Time " + QByteArray::number(i);
+        const QByteArray offset = QByteArray::number(100 + i % 12 * 100).rightJustified(4, '0');
+        const QByteArray dstOffset = QByteArray::number(200 + i % 12 * 100).rightJustified(4, '0');
+        file.write("BEGIN:VTIMEZONE\r\n"
+                   "TZID:" + tzid + "\r\n"
+                   "BEGIN:STANDARD\r\n"
+                   "DTSTART:16010101T030000\r\n"
+                   "TZOFFSETFROM:+" + dstOffset + "\r\n"
+                   "TZOFFSETTO:+" + offset + "\r\n"
+                   "RRULE:FREQ=YEARLY;BYDAY=-1SU;BYMONTH=10\r\n"
+                   "END:STANDARD\r\n"
+                   "BEGIN:DAYLIGHT\r\n"
+                   "DTSTART:16010101T020000\r\n"
+                   "TZOFFSETFROM:+" + offset + "\r\n"
+                   "TZOFFSETTO:+" + dstOffset + "\r\n"
+                   "RRULE:FREQ=YEARLY;BYDAY=-1SU;BYMONTH=3\r\n"
+                   "END:DAYLIGHT\r\n"
+                   "END:VTIMEZONE\r\n");
+        tzids.append(tzid);
+    }
+
+    const QDate start(2019, 1, 1);
+    for (int i = 0; i < eventCount; ++i) {
+        const QByteArray tzid = tzids.at(i % tzids.count());
+        const QByteArray date = start.addDays(i % 1000).toString(QStringLiteral("yyyyMMdd")).toLatin1();
+        file.write("BEGIN:VEVENT\r\n"
+                   "UID:event-" + QByteArray::number(i) + "\r\n"
+                   "DTSTAMP:20190101T000000Z\r\n"
+                   "DTSTART;TZID=" + tzid + ":" + date + "T090000\r\n"
+                   "DTEND;TZID=" + tzid + ":" + date + "T100000\r\n"
+                   "SUMMARY:Event " + QByteArray::number(i) + "\r\n"
+                   "END:VEVENT\r\n");
+    }
+    file.write("END:VCALENDAR\r\n");
+}
+
+void ICalFormatBenchmark::benchmarkLoadTimeZones()
+{
+    QBENCHMARK {
+        MemoryCalendar::Ptr calendar(new MemoryCalendar(QTimeZone::utc()));
+        ICalFormat format;
+        QVERIFY(format.load(calendar, mFileName));
+        QCOMPARE(calendar->rawEvents().count(), eventCount);
+    }
+}
@@ -0,0 +1,125 @@
+/*
+  This file is part of the kcalcore library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with this library; see the file COPYING.LIB.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+#include "benchmarkmemorycalendar.h"
+#include "event.h"
+#include "journal.h"
+#include "memorycalendar.h"
+#include "todo.h"
+
+#include <QTest>
+#include <QTimeZone>
+
+QTEST_MAIN(MemoryCalendarBenchmark)
+
+using namespace KCalendarCore;
+
+static const int incidenceCount = 20000;
+static const int dayCount = 365;
+static const QDate firstDay(2019, 1, 1);
+
+void MemoryCalendarBenchmark::initTestCase()
+{
+    mIncidences.reserve(incidenceCount);
+    for (int i = 0; i < incidenceCount; ++i) {
+        const QDateTime start(firstDay.addDays(i % dayCount), QTime(8 + i % 10, 0), QTimeZone::utc());
+        Incidence::Ptr incidence;
+        switch (i % 3) {
+        case 0: {
+            Event::Ptr event(new Event);
+            event->setDtStart(start);
+            event->setDtEnd(start.addSecs(3600));
+            incidence = event;
+            break;
+        }
+        case 1: {
+            Todo::Ptr todo(new Todo);
+            todo->setDtDue(start);
+            incidence = todo;
+            break;
+        }
+        default: {
+            Journal::Ptr journal(new Journal);
+            journal->setDtStart(start);
+            incidence = journal;
+            break;
+        }
+        }
+        incidence->setUid(QStringLiteral("incidence-%1").arg(i));
+        incidence->setSummary(QStringLiteral("Incidence %1").arg(i));
+        mIncidences.append(incidence);
+    }
+}
+
+void MemoryCalendarBenchmark::benchmarkAddDelete()
+{
+    QBENCHMARK {
+        MemoryCalendar::Ptr calendar(new MemoryCalendar(QTimeZone::utc()));
+        for (const Incidence::Ptr &incidence : qAsConst(mIncidences)) {
+            calendar->addIncidence(incidence);
+        }
+        for (const Incidence::Ptr &incidence : qAsConst(mIncidences)) {
+            calendar->deleteIncidence(incidence);
+        }
+        QVERIFY(calendar->rawEvents().isEmpty());
+    }
+}
+
+void MemoryCalendarBenchmark::benchmarkAddIncidences()
+{
+    QBENCHMARK {
+        MemoryCalendar::Ptr calendar(new MemoryCalendar(QTimeZone::utc()));
+        QVERIFY(calendar->addIncidences(mIncidences));
+        QCOMPARE(calendar->rawEvents().count(), (incidenceCount + 2) / 3);
+        calendar->close();
+    }
+}
+
+void MemoryCalendarBenchmark::benchmarkEventsForDate()
+{
+    MemoryCalendar::Ptr calendar(new MemoryCalendar(QTimeZone::utc()));
+    for (const Incidence::Ptr &incidence : qAsConst(mIncidences)) {
+        calendar->addIncidence(incidence);
+    }
+
+    QBENCHMARK {
+        for (int day = 0; day < dayCount; ++day) {
+            QVERIFY(!calendar->rawEventsForDate(firstDay.addDays(day)).isEmpty());
+        }
+    }
+}
+
+void MemoryCalendarBenchmark::benchmarkDayView()
+{
+    MemoryCalendar::Ptr calendar(new MemoryCalendar(QTimeZone::utc()));
+    for (const Incidence::Ptr &incidence : qAsConst(mIncidences)) {
+        calendar->addIncidence(incidence);
+    }
+
+    // What a day view asks the calendar for every day it shows
+    QBENCHMARK {
+        for (int day = 0; day < dayCount; ++day) {
+            const QDate date = firstDay.addDays(day);
+            const int count = calendar->rawEventsForDate(date).count()
+                              + calendar->rawTodosForDate(date).count()
+                              + calendar->rawJournalsForDate(date).count();
+            QVERIFY(count > 0);
+        }
+    }
+}
@@ -0,0 +1,90 @@
+/*
+  This file is part of the kcalcore library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with this library; see the file COPYING.LIB.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+#include "benchmarksnapshotformat.h"
+#include "event.h"
+#include "icalformat.h"
+#include "memorycalendar.h"
+#include "snapshotformat.h"
+#include "todo.h"
+
+#include <QTest>
+#include <QTimeZone>
+
+QTEST_MAIN(SnapshotFormatBenchmark)
+
+using namespace KCalendarCore;
+
+static const int eventCount = 20000;
+static const int todoCount = 5000;
+
+void SnapshotFormatBenchmark::initTestCase()
+{
+    QVERIFY(mDir.isValid());
+    mICalFileName = mDir.filePath(QStringLiteral("calendar.ics"));
+    mSnapshotFileName = mDir.filePath(QStringLiteral("calendar.snapshot"));
+
+    const QTimeZone tz("Europe/Berlin");
+    MemoryCalendar::Ptr calendar(new MemoryCalendar(QTimeZone::utc()));
+    for (int i = 0; i < eventCount; ++i) {
+        Event::Ptr event(new Event);
+        event->setUid(QStringLiteral("event-%1").arg(i));
+        event->setSummary(QStringLiteral("Event %1").arg(i));
+        event->setDescription(QStringLiteral("Description of event %1").arg(i));
+        event->setLocation(QStringLiteral("Room %1").arg(i % 20));
+        event->setDtStart(QDateTime(QDate(2019, 1, 1).addDays(i % 365), QTime(8 + i % 10, 0), tz));
+        event->setDtEnd(event->dtStart().addSecs(3600));
+        if (i % 10 == 0) {
+            event->recurrence()->setWeekly(1);
+        }
+        calendar->addEvent(event);
+    }
+    for (int i = 0; i < todoCount; ++i) {
+        Todo::Ptr todo(new Todo);
+        todo->setUid(QStringLiteral("todo-%1").arg(i));
+        todo->setSummary(QStringLiteral("Todo %1").arg(i));
+        todo->setDtDue(QDateTime(QDate(2019, 1, 1).addDays(i % 365), QTime(12, 0), Qt::UTC));
+        calendar->addTodo(todo);
+    }
+
+    ICalFormat iCal;
+    QVERIFY(iCal.save(calendar, mICalFileName));
+    SnapshotFormat snapshot;
+    QVERIFY(snapshot.save(calendar, mSnapshotFileName));
+}
+
+void SnapshotFormatBenchmark::benchmarkLoadICal()
+{
+    QBENCHMARK {
+        MemoryCalendar::Ptr calendar(new MemoryCalendar(QTimeZone::utc()));
+        ICalFormat format;
+        QVERIFY(format.load(calendar, mICalFileName));
+        QCOMPARE(calendar->rawEvents().count(), eventCount);
+    }
+}
+
+void SnapshotFormatBenchmark::benchmarkLoadSnapshot()
+{
+    QBENCHMARK {
+        MemoryCalendar::Ptr calendar(new MemoryCalendar(QTimeZone::utc()));
+        SnapshotFormat format;
+        QVERIFY(format.load(calendar, mSnapshotFileName));
+        QCOMPARE(calendar->rawEvents().count(), eventCount);
+    }
+}
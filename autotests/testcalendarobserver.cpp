@@ -32,6 +32,7 @@ QTEST_MAIN(CalendarObserverTest)
 
 using namespace KCalendarCore;
 Q_DECLARE_METATYPE(KCalendarCore::Incidence::Ptr)
+Q_DECLARE_METATYPE(KCalendarCore::Incidence::List)
 Q_DECLARE_METATYPE(const Calendar *)
 
 class SimpleObserver : public QObject, public Calendar::CalendarObserver
@@ -75,6 +76,30 @@ protected:
     }
 };
 
+class BatchingObserver : public SimpleObserver, public Calendar::BatchObserver
+{
+    Q_OBJECT
+public:
+    using SimpleObserver::SimpleObserver;
+
+Q_SIGNALS:
+    void incidencesAdded(const KCalendarCore::Incidence::List &incidences);
+    void incidencesChanged(const KCalendarCore::Incidence::List &incidences);
+protected:
+    void calendarIncidencesAdded(const KCalendarCore::Incidence::List &incidences) override
+    {
+        for (const Incidence::Ptr &incidence : incidences) {
+            QVERIFY(mCal->incidences().contains(incidence));
+        }
+        Q_EMIT incidencesAdded(incidences);
+    }
+
+    void calendarIncidencesChanged(const KCalendarCore::Incidence::List &incidences) override
+    {
+        Q_EMIT incidencesChanged(incidences);
+    }
+};
+
 void CalendarObserverTest::testAdd()
 {
     qRegisterMetaType<KCalendarCore::Incidence::Ptr>();
@@ -91,6 +116,33 @@ void CalendarObserverTest::testAdd()
     QCOMPARE(arguments.at(0).value<KCalendarCore::Incidence::Ptr>(), static_cast<KCalendarCore::Incidence::Ptr>(event1));
 }
 
+void CalendarObserverTest::testAddMany()
+{
+    qRegisterMetaType<KCalendarCore::Incidence::Ptr>();
+    qRegisterMetaType<KCalendarCore::Incidence::List>();
+    MemoryCalendar::Ptr cal(new MemoryCalendar(QTimeZone::utc()));
+    SimpleObserver simpleOb(cal.data());
+    BatchingObserver batchOb(cal.data());
+    QSignalSpy simpleSpy(&simpleOb, &SimpleObserver::incidenceAdded);
+    QSignalSpy batchSpy(&batchOb, &BatchingObserver::incidencesAdded);
+    QSignalSpy singleSpy(&batchOb, &SimpleObserver::incidenceAdded);
+    cal->registerObserver(&simpleOb);
+    cal->registerObserver(&batchOb);
+
+    Incidence::List incidences;
+    for (int i = 0; i < 3; ++i) {
+        Event::Ptr event(new Event());
+        event->setUid(QString::number(i));
+        incidences.append(event);
+    }
+    QVERIFY(cal->addIncidences(incidences));
+
+    QCOMPARE(simpleSpy.count(), 3);
+    QCOMPARE(singleSpy.count(), 0);
+    QCOMPARE(batchSpy.count(), 1);
+    QCOMPARE(batchSpy.at(0).at(0).value<KCalendarCore::Incidence::List>(), incidences);
+}
+
 void CalendarObserverTest::testChange()
 {
     qRegisterMetaType<KCalendarCore::Incidence::Ptr>();
@@ -109,6 +161,93 @@ void CalendarObserverTest::testChange()
     QCOMPARE(arguments.at(0).value<KCalendarCore::Incidence::Ptr>(), static_cast<KCalendarCore::Incidence::Ptr>(event1));
 }
 
+void CalendarObserverTest::testChangeMany()
+{
+    qRegisterMetaType<KCalendarCore::Incidence::Ptr>();
+    qRegisterMetaType<KCalendarCore::Incidence::List>();
+    MemoryCalendar::Ptr cal(new MemoryCalendar(QTimeZone::utc()));
+    SimpleObserver simpleOb(cal.data());
+    BatchingObserver batchOb(cal.data());
+    QSignalSpy simpleSpy(&simpleOb, &SimpleObserver::incidenceChanged);
+    QSignalSpy batchSpy(&batchOb, &BatchingObserver::incidencesChanged);
+    QSignalSpy singleSpy(&batchOb, &SimpleObserver::incidenceChanged);
+    cal->registerObserver(&simpleOb);
+    cal->registerObserver(&batchOb);
+
+    Event::List events;
+    for (int i = 0; i < 3; ++i) {
+        Event::Ptr event(new Event());
+        event->setUid(QString::number(i));
+        QVERIFY(cal->addEvent(event));
+        event->resetDirtyFields();
+        events.append(event);
+    }
+
+    cal->startBatchChanges();
+    cal->startBatchChanges();
+    events[0]->setSummary(QStringLiteral("summary"));
+    events[0]->resetDirtyFields();
+    events[0]->setDescription(QStringLiteral("desc"));
+    events[1]->setLocation(QStringLiteral("here"));
+    events[2]->setLocation(QStringLiteral("there"));
+    QVERIFY(cal->deleteEvent(events[2]));
+    cal->endBatchChanges();
+    QCOMPARE(simpleSpy.count(), 0);
+    QCOMPARE(batchSpy.count(), 0);
+    cal->endBatchChanges();
+
+    QCOMPARE(simpleSpy.count(), 2);
+    QCOMPARE(singleSpy.count(), 0);
+    QCOMPARE(batchSpy.count(), 1);
+    QCOMPARE(batchSpy.at(0).at(0).value<KCalendarCore::Incidence::List>(),
+             Incidence::List() << events[0] << events[1]);
+    QVERIFY(events[0]->dirtyFields().contains(IncidenceBase::FieldSummary));
+    QVERIFY(events[0]->dirtyFields().contains(IncidenceBase::FieldDescription));
+
+    // Outside of a batch, changes are reported one by one again
+    events[1]->setLocation(QStringLiteral("elsewhere"));
+    QCOMPARE(simpleSpy.count(), 3);
+    QCOMPARE(singleSpy.count(), 1);
+    QCOMPARE(batchSpy.count(), 1);
+}
+
+void CalendarObserverTest::testChangeUidInBatch()
+{
+    qRegisterMetaType<KCalendarCore::Incidence::Ptr>();
+    qRegisterMetaType<KCalendarCore::Incidence::List>();
+    MemoryCalendar::Ptr cal(new MemoryCalendar(QTimeZone::utc()));
+    SimpleObserver simpleOb(cal.data());
+    BatchingObserver batchOb(cal.data());
+    QSignalSpy simpleSpy(&simpleOb, &SimpleObserver::incidenceChanged);
+    QSignalSpy batchSpy(&batchOb, &BatchingObserver::incidencesChanged);
+    cal->registerObserver(&simpleOb);
+    cal->registerObserver(&batchOb);
+
+    Event::Ptr renamed(new Event());
+    renamed->setUid(QStringLiteral("1"));
+    QVERIFY(cal->addEvent(renamed));
+    Event::Ptr deleted(new Event());
+    deleted->setUid(QStringLiteral("2"));
+    QVERIFY(cal->addEvent(deleted));
+
+    cal->startBatchChanges();
+    renamed->setSummary(QStringLiteral("summary"));
+    renamed->setUid(QStringLiteral("3"));
+    renamed->setLocation(QStringLiteral("here"));
+    deleted->setSummary(QStringLiteral("summary"));
+    deleted->setUid(QStringLiteral("4"));
+    QVERIFY(cal->deleteEvent(deleted));
+    cal->endBatchChanges();
+
+    // Each incidence is reported once, and deleted ones not at all
+    QCOMPARE(simpleSpy.count(), 1);
+    QCOMPARE(simpleSpy.at(0).at(0).value<KCalendarCore::Incidence::Ptr>(),
+             static_cast<KCalendarCore::Incidence::Ptr>(renamed));
+    QCOMPARE(batchSpy.count(), 1);
+    QCOMPARE(batchSpy.at(0).at(0).value<KCalendarCore::Incidence::List>(),
+             Incidence::List() << renamed);
+}
+
 void CalendarObserverTest::testDelete()
 {
     qRegisterMetaType<KCalendarCore::Incidence::Ptr>();
@@ -29,7 +29,10 @@ class CalendarObserverTest : public QObject
     Q_OBJECT
 private Q_SLOTS:
     void testAdd();
+    void testAddMany();
     void testChange();
+    void testChangeMany();
+    void testChangeUidInBatch();
     void testDelete();
 };
 
@@ -111,3 +111,132 @@ void FreeBusyTest::testDataStream()
     QCOMPARE(fb1->busyPeriods(), fb2->busyPeriods());
 //   QVERIFY( *fb1 == *fb2 );
 }
+
+void FreeBusyTest::testEvents()
+{
+    const QDateTime start(QDate(2019, 6, 3), QTime(0, 0, 0), Qt::UTC);
+    const QDateTime end(QDate(2019, 6, 6), QTime(0, 0, 0), Qt::UTC);
+    Event::List events;
+
+    Event::Ptr daily(new Event());
+    daily->setDtStart(QDateTime(QDate(2019, 6, 1), QTime(9, 0, 0), Qt::UTC));
+    daily->setDtEnd(QDateTime(QDate(2019, 6, 1), QTime(10, 0, 0), Qt::UTC));
+    daily->recurrence()->setDaily(1);
+    events << daily;
+
+    // Overlaps one of the daily occurrences
+    Event::Ptr overlapping(new Event());
+    overlapping->setDtStart(QDateTime(QDate(2019, 6, 4), QTime(9, 30, 0), Qt::UTC));
+    overlapping->setDtEnd(QDateTime(QDate(2019, 6, 4), QTime(11, 0, 0), Qt::UTC));
+    events << overlapping;
+
+    Event::Ptr transparent(new Event());
+    transparent->setDtStart(QDateTime(QDate(2019, 6, 5), QTime(14, 0, 0), Qt::UTC));
+    transparent->setDtEnd(QDateTime(QDate(2019, 6, 5), QTime(15, 0, 0), Qt::UTC));
+    transparent->setTransparency(Event::Transparent);
+    events << transparent;
+
+    Event::Ptr allDay(new Event());
+    allDay->setDtStart(QDateTime(QDate(2019, 6, 5), QTime(0, 0, 0), Qt::UTC));
+    allDay->setDtEnd(QDateTime(QDate(2019, 6, 5), QTime(0, 0, 0), Qt::UTC));
+    allDay->setAllDay(true);
+    events << allDay;
+
+    // Starts before the requested period
+    Event::Ptr early(new Event());
+    early->setDtStart(QDateTime(QDate(2019, 6, 2), QTime(22, 0, 0), Qt::UTC));
+    early->setDtEnd(QDateTime(QDate(2019, 6, 3), QTime(1, 0, 0), Qt::UTC));
+    events << early;
+
+    FreeBusy fb(events, start, end);
+    const Period::List busyPeriods = fb.busyPeriods();
+    QCOMPARE(busyPeriods.count(), 4);
+    QCOMPARE(busyPeriods.at(0).start(), start);
+    QCOMPARE(busyPeriods.at(0).end(), QDateTime(QDate(2019, 6, 3), QTime(1, 0, 0), Qt::UTC));
+    QCOMPARE(busyPeriods.at(1).start(), QDateTime(QDate(2019, 6, 3), QTime(9, 0, 0), Qt::UTC));
+    QCOMPARE(busyPeriods.at(1).end(), QDateTime(QDate(2019, 6, 3), QTime(10, 0, 0), Qt::UTC));
+    QCOMPARE(busyPeriods.at(2).start(), QDateTime(QDate(2019, 6, 4), QTime(9, 0, 0), Qt::UTC));
+    QCOMPARE(busyPeriods.at(2).end(), QDateTime(QDate(2019, 6, 4), QTime(11, 0, 0), Qt::UTC));
+    QCOMPARE(busyPeriods.at(3).start(), QDateTime(QDate(2019, 6, 5), QTime(0, 0, 0), Qt::UTC));
+    QCOMPARE(busyPeriods.at(3).end(), QDateTime(QDate(2019, 6, 5), QTime(23, 59, 59, 999), Qt::UTC));
+
+    // More occurrences than the recurrence rules expand at once
+    const QDateTime frequentStart(QDate(2019, 7, 1), QTime(0, 0, 0), Qt::UTC);
+    Event::Ptr frequent(new Event());
+    frequent->setDtStart(frequentStart);
+    frequent->setDtEnd(frequentStart.addSecs(60));
+    frequent->recurrence()->setMinutely(5);
+    FreeBusy frequentFb(Event::List() << frequent, frequentStart, frequentStart.addDays(90).addSecs(-60));
+    const Period::List frequentPeriods = frequentFb.busyPeriods();
+    QCOMPARE(frequentPeriods.count(), 90 * 24 * 12);
+    QCOMPARE(frequentPeriods.first().start(), frequentStart);
+    QCOMPARE(frequentPeriods.last().start(), frequentStart.addDays(90).addSecs(-300));
+}
+
+void FreeBusyTest::testNormalized()
+{
+    const QDateTime dt(QDate(2019, 6, 3), QTime(9, 0, 0), Qt::UTC);
+    FreeBusy fb(dt, dt.addDays(1));
+    fb.addPeriod(dt.addSecs(2 * 3600), dt.addSecs(3 * 3600));
+    fb.addPeriod(dt, dt.addSecs(3600));
+    fb.addPeriod(dt.addSecs(1800), dt.addSecs(2 * 3600));
+    QCOMPARE(fb.busyPeriods().count(), 3);
+
+    fb.setNormalized(true);
+    QVERIFY(fb.isNormalized());
+    // Overlapping and adjacent periods are coalesced
+    QCOMPARE(fb.busyPeriods().count(), 1);
+    QCOMPARE(fb.busyPeriods().at(0).start(), dt);
+    QCOMPARE(fb.busyPeriods().at(0).end(), dt.addSecs(3 * 3600));
+
+    fb.addPeriod(dt.addSecs(5 * 3600), Duration(3600));
+    fb.addPeriod(dt.addSecs(4 * 3600), dt.addSecs(4 * 3600 + 1800));
+    QCOMPARE(fb.busyPeriods().count(), 3);
+
+    // Periods of different types are not coalesced
+    FreeBusyPeriod tentative(dt.addSecs(4 * 3600), dt.addSecs(6 * 3600));
+    tentative.setType(FreeBusyPeriod::BusyTentative);
+    FreeBusy::Ptr other(new FreeBusy(FreeBusyPeriod::List{tentative}));
+    other->setDtStart(dt.addDays(-1));
+    fb.merge(other);
+    QCOMPARE(fb.dtStart(), dt.addDays(-1));
+    const FreeBusyPeriod::List periods = fb.fullBusyPeriods();
+    QCOMPARE(periods.count(), 4);
+    QCOMPARE(periods.at(1).type(), FreeBusyPeriod::Busy);
+    QCOMPARE(periods.at(2).type(), FreeBusyPeriod::BusyTentative);
+    QCOMPARE(periods.at(2).end(), dt.addSecs(6 * 3600));
+
+    // The busy periods merged are coalesced as well
+    FreeBusy::Ptr busy(new FreeBusy(dt, dt.addDays(1)));
+    busy->addPeriod(dt.addSecs(4 * 3600 + 1800), dt.addSecs(5 * 3600));
+    fb.merge(busy);
+    QCOMPARE(fb.fullBusyPeriods().count(), 3);
+    QCOMPARE(fb.fullBusyPeriods().at(1).end(), dt.addSecs(6 * 3600));
+}
+
+void FreeBusyTest::testFreePeriods()
+{
+    const QDateTime dt(QDate(2019, 6, 3), QTime(9, 0, 0), Qt::UTC);
+    FreeBusy fb(dt, dt.addDays(1));
+    fb.addPeriod(dt.addSecs(3600), dt.addSecs(2 * 3600));
+    fb.addPeriod(dt.addSecs(1800), dt.addSecs(3600 + 1800));
+    FreeBusyPeriod free(dt.addSecs(3 * 3600), dt.addSecs(4 * 3600));
+    free.setType(FreeBusyPeriod::Free);
+    fb.addPeriods(FreeBusyPeriod::List{free});
+    fb.addPeriod(dt.addSecs(5 * 3600), dt.addSecs(6 * 3600));
+
+    for (bool normalized : {false, true}) {
+        fb.setNormalized(normalized);
+        Period::List periods = fb.freePeriods(dt, dt.addSecs(8 * 3600));
+        QCOMPARE(periods.count(), 3);
+        QCOMPARE(periods.at(0), Period(dt, dt.addSecs(1800)));
+        QCOMPARE(periods.at(1), Period(dt.addSecs(2 * 3600), dt.addSecs(5 * 3600)));
+        QCOMPARE(periods.at(2), Period(dt.addSecs(6 * 3600), dt.addSecs(8 * 3600)));
+
+        periods = fb.freePeriods(dt.addSecs(3600), dt.addSecs(5 * 3600 + 1800));
+        QCOMPARE(periods.count(), 1);
+        QCOMPARE(periods.at(0), Period(dt.addSecs(2 * 3600), dt.addSecs(5 * 3600)));
+
+        QVERIFY(fb.freePeriods(dt.addSecs(5 * 3600), dt.addSecs(6 * 3600)).isEmpty());
+    }
+}
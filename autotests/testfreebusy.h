@@ -32,6 +32,9 @@ private Q_SLOTS:
     void testAddSort();
     void testAssign();
     void testDataStream();
+    void testEvents();
+    void testNormalized();
+    void testFreePeriods();
 };
 
 #endif
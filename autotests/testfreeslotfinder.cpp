@@ -0,0 +1,169 @@
+/*
+  This file is part of the kcalcore library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with this library; see the file COPYING.LIB.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+#include "testfreeslotfinder.h"
+#include "freeslotfinder.h"
+
+#include <QTest>
+QTEST_MAIN(FreeSlotFinderTest)
+
+using namespace KCalendarCore;
+
+static const QDateTime windowStart(QDate(2019, 6, 3), QTime(0, 0, 0), Qt::UTC);
+static const QDateTime windowEnd(QDate(2019, 6, 5), QTime(0, 0, 0), Qt::UTC);
+
+static QDateTime at(int day, int hour)
+{
+    return QDateTime(QDate(2019, 6, day), QTime(hour, 0, 0), Qt::UTC);
+}
+
+void FreeSlotFinderTest::testEmpty()
+{
+    FreeSlotFinder finder;
+    const Period::List freeSlots = finder.findSlots(windowStart, windowEnd, Duration(3600), 5);
+    QCOMPARE(freeSlots.count(), 1);
+    QCOMPARE(freeSlots.at(0), Period(windowStart, windowEnd));
+
+    QVERIFY(finder.findSlots(windowEnd, windowStart, Duration(3600)).isEmpty());
+    QVERIFY(finder.findSlots(windowStart, windowEnd, Duration(3600), 0).isEmpty());
+}
+
+void FreeSlotFinderTest::testCommonFree()
+{
+    FreeBusy::Ptr first(new FreeBusy(windowStart, windowEnd));
+    first->addPeriod(at(3, 13), at(3, 14));
+    first->addPeriod(at(3, 9), at(3, 10));
+    FreeBusyPeriod free(at(3, 11), at(3, 12));
+    free.setType(FreeBusyPeriod::Free);
+    FreeBusy::Ptr second(new FreeBusy(windowStart, windowEnd));
+    second->addPeriods(FreeBusyPeriod::List{FreeBusyPeriod(at(3, 9).addSecs(1800), at(3, 11)),
+                                            free,
+                                            FreeBusyPeriod(at(4, 10), at(4, 12))});
+
+    FreeSlotFinder finder(FreeBusy::List{first, second});
+    finder.setTimeZone(QTimeZone::utc());
+
+    Period::List freeSlots = finder.findSlots(windowStart, windowEnd, Duration(3600), 10);
+    QCOMPARE(freeSlots.count(), 4);
+    QCOMPARE(freeSlots.at(0), Period(windowStart, at(3, 9)));
+    QCOMPARE(freeSlots.at(1), Period(at(3, 11), at(3, 13)));
+    QCOMPARE(freeSlots.at(2), Period(at(3, 14), at(4, 10)));
+    QCOMPARE(freeSlots.at(3), Period(at(4, 12), windowEnd));
+
+    // Too short free time is skipped
+    freeSlots = finder.findSlots(windowStart, windowEnd, Duration(3 * 3600), 10);
+    QCOMPARE(freeSlots.count(), 3);
+    QCOMPARE(freeSlots.at(1), Period(at(3, 14), at(4, 10)));
+
+    // Only the first slots are returned
+    freeSlots = finder.findSlots(windowStart, windowEnd, Duration(3600), 2);
+    QCOMPARE(freeSlots.count(), 2);
+    QCOMPARE(freeSlots.at(1), Period(at(3, 11), at(3, 13)));
+
+    // The search may start within a busy period
+    freeSlots = finder.findSlots(at(3, 10), windowEnd, Duration(3600));
+    QCOMPARE(freeSlots.count(), 1);
+    QCOMPARE(freeSlots.at(0), Period(at(3, 11), at(3, 13)));
+}
+
+void FreeSlotFinderTest::testWorkingHours()
+{
+    FreeBusy::Ptr first(new FreeBusy(windowStart, windowEnd));
+    first->addPeriod(at(3, 13), at(3, 14));
+    first->addPeriod(at(3, 9), at(3, 10));
+    FreeBusyPeriod free(at(3, 11), at(3, 12));
+    free.setType(FreeBusyPeriod::Free);
+    FreeBusy::Ptr second(new FreeBusy(windowStart, windowEnd));
+    second->addPeriods(FreeBusyPeriod::List{FreeBusyPeriod(at(3, 9).addSecs(1800), at(3, 11)),
+                                            free,
+                                            FreeBusyPeriod(at(4, 10), at(4, 12))});
+
+    FreeSlotFinder finder(FreeBusy::List{first, second});
+    finder.setTimeZone(QTimeZone::utc());
+    finder.setWorkingHours(QTime(9, 0), QTime(17, 0));
+    QCOMPARE(finder.workingHoursStart(), QTime(9, 0));
+    QCOMPARE(finder.workingHoursEnd(), QTime(17, 0));
+
+    const Period::List freeSlots = finder.findSlots(windowStart, windowEnd, Duration(3600), 10);
+    QCOMPARE(freeSlots.count(), 4);
+    QCOMPARE(freeSlots.at(0), Period(at(3, 11), at(3, 13)));
+    QCOMPARE(freeSlots.at(1), Period(at(3, 14), at(3, 17)));
+    QCOMPARE(freeSlots.at(2), Period(at(4, 9), at(4, 10)));
+    QCOMPARE(freeSlots.at(3), Period(at(4, 12), at(4, 17)));
+}
+
+void FreeSlotFinderTest::testWorkingDays()
+{
+    FreeBusy::Ptr first(new FreeBusy(windowStart, windowEnd));
+    first->addPeriod(at(3, 13), at(3, 14));
+    first->addPeriod(at(3, 9), at(3, 10));
+    FreeBusyPeriod free(at(3, 11), at(3, 12));
+    free.setType(FreeBusyPeriod::Free);
+    FreeBusy::Ptr second(new FreeBusy(windowStart, windowEnd));
+    second->addPeriods(FreeBusyPeriod::List{FreeBusyPeriod(at(3, 9).addSecs(1800), at(3, 11)),
+                                            free,
+                                            FreeBusyPeriod(at(4, 10), at(4, 12))});
+
+    FreeSlotFinder finder(FreeBusy::List{first, second});
+    finder.setTimeZone(QTimeZone::utc());
+
+    // Monday and Tuesday; free time over midnight is not split
+    QBitArray days(7);
+    days.setBit(0);
+    days.setBit(1);
+    finder.setWorkingDays(days);
+    QCOMPARE(finder.workingDays(), days);
+    Period::List freeSlots = finder.findSlots(windowStart, windowEnd, Duration(3600), 10);
+    QCOMPARE(freeSlots.count(), 4);
+    QCOMPARE(freeSlots.at(2), Period(at(3, 14), at(4, 10)));
+
+    // Tuesday only
+    days.clearBit(0);
+    finder.setWorkingDays(days);
+    finder.setWorkingHours(QTime(9, 0), QTime(17, 0));
+    freeSlots = finder.findSlots(windowStart, windowEnd, Duration(3600), 10);
+    QCOMPARE(freeSlots.count(), 2);
+    QCOMPARE(freeSlots.at(0), Period(at(4, 9), at(4, 10)));
+    QCOMPARE(freeSlots.at(1), Period(at(4, 12), at(4, 17)));
+}
+
+void FreeSlotFinderTest::testOverMidnight()
+{
+    // Free from Monday 23:30 until Tuesday 00:30
+    FreeBusy::Ptr freeBusy(new FreeBusy(windowStart, windowEnd));
+    freeBusy->addPeriod(windowStart, at(3, 23).addSecs(1800));
+    freeBusy->addPeriod(at(4, 0).addSecs(1800), windowEnd);
+
+    FreeSlotFinder finder(FreeBusy::List{freeBusy});
+    finder.setTimeZone(QTimeZone::utc());
+    QBitArray days(7);
+    days.setBit(0);
+    days.setBit(1);
+    finder.setWorkingDays(days);
+
+    // Neither day alone is long enough, together they are
+    const Period::List freeSlots = finder.findSlots(windowStart, windowEnd, Duration(3600), 10);
+    QCOMPARE(freeSlots.count(), 1);
+    QCOMPARE(freeSlots.at(0), Period(at(3, 23).addSecs(1800), at(4, 0).addSecs(1800)));
+
+    // Unless the second day is not a working day
+    days.clearBit(1);
+    finder.setWorkingDays(days);
+    QVERIFY(finder.findSlots(windowStart, windowEnd, Duration(3600), 10).isEmpty());
+}
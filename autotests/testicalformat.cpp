@@ -22,10 +22,13 @@
 
 #include "testicalformat.h"
 #include "event.h"
+#include "exceptions.h"
 #include "icalformat.h"
 #include "memorycalendar.h"
+#include "todo.h"
 
 #include <QDebug>
+#include <QTemporaryFile>
 #include <QTest>
 #include <QTimeZone>
 
@@ -170,3 +173,189 @@ void ICalFormatTest::testAlarm()
     Alarm::Ptr alarm2 = event2->alarms()[0];
     QCOMPARE(*alarm, *alarm2);
 }
+
+void ICalFormatTest::testLoadIncrementally()
+{
+    // The time zone is only defined after the event using it
+    const QByteArray data
+        = "BEGIN:VCALENDAR\r\n"
+          "PRODID:-//K Desktop Environment//NONSGML libkcal 3.2//EN\r\n"
+          "VERSION:2.0\r\n"
+          "X-TEST-PROPERTY:value\r\n"
+          "BEGIN:VEVENT\r\n"
+          "UID:event-1\r\n"
+          "DTSTART;TZID=Test/Zone:20190101T100000\r\n"
+          "DTEND;TZID=Test/Zone:20190101T110000\r\n"
+          "SUMMARY:A summary which is long enough to be fold\r\n"
+          " ed over two lines\r\n"
+          "BEGIN:VALARM\r\n"
+          "ACTION:DISPLAY\r\n"
+          "TRIGGER:-PT15M\r\n"
+          "END:VALARM\r\n"
+          "END:VEVENT\r\n"
+          "BEGIN:VTODO\r\n"
+          "UID:todo-1\r\n"
+          "DTSTART:20190102T100000Z\r\n"
+          "SUMMARY:Todo\r\n"
+          "END:VTODO\r\n"
+          "BEGIN:VJOURNAL\r\n"
+          "UID:journal-1\r\n"
+          "DTSTART;VALUE=DATE:20190103\r\n"
+          "SUMMARY:Journal\r\n"
+          "END:VJOURNAL\r\n"
+          "BEGIN:VTIMEZONE\r\n"
+          "TZID:Test/Zone\r\n"
+          "BEGIN:STANDARD\r\n"
+          "DTSTART:19700101T000000\r\n"
+          "TZOFFSETFROM:+0300\r\n"
+          "TZOFFSETTO:+0300\r\n"
+          "END:STANDARD\r\n"
+          "END:VTIMEZONE\r\n"
+          "END:VCALENDAR\r\n";
+
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QCOMPARE(file.write(data), qint64(data.size()));
+    file.close();
+
+    ICalFormat format;
+    MemoryCalendar::Ptr loaded(new MemoryCalendar(QTimeZone::utc()));
+    QVERIFY(format.load(loaded, file.fileName()));
+    QCOMPARE(format.loadedProductId(), QStringLiteral("-//K Desktop Environment//NONSGML libkcal 3.2//EN"));
+    QCOMPARE(loaded->nonKDECustomProperty("X-TEST-PROPERTY"), QStringLiteral("value"));
+
+    MemoryCalendar::Ptr parsed(new MemoryCalendar(QTimeZone::utc()));
+    QVERIFY(format.fromRawString(parsed, data));
+
+    QCOMPARE(loaded->incidences().count(), 3);
+    QCOMPARE(loaded->incidences().count(), parsed->incidences().count());
+    const Incidence::List incidences = parsed->incidences();
+    for (const Incidence::Ptr &incidence : incidences) {
+        const Incidence::Ptr other = loaded->incidence(incidence->uid());
+        QVERIFY(other);
+        QCOMPARE(*other, *incidence);
+    }
+
+    const Event::Ptr event = loaded->event(QStringLiteral("event-1"));
+    QVERIFY(event);
+    QCOMPARE(event->summary(), QStringLiteral("A summary which is long enough to be folded over two lines"));
+    QCOMPARE(event->dtStart().toUTC(), QDateTime(QDate(2019, 1, 1), QTime(7, 0), Qt::UTC));
+    QCOMPARE(event->alarms().count(), 1);
+
+    // Empty files are valid, files without calendar are not
+    QVERIFY(file.open());
+    file.resize(0);
+    file.close();
+    QVERIFY(format.load(loaded, file.fileName()));
+    QCOMPARE(loaded->incidences().count(), 3);
+
+    QVERIFY(file.open());
+    file.write("BEGIN:VEVENT\r\nUID:event-2\r\nEND:VEVENT\r\n");
+    file.close();
+    QVERIFY(!format.load(loaded, file.fileName()));
+    QVERIFY(format.exception());
+    QCOMPARE(format.exception()->code(), Exception::NoCalendar);
+}
+
+void ICalFormatTest::testSaveIncrementally()
+{
+    const QTimeZone tz("Europe/Prague");
+    MemoryCalendar::Ptr calendar(new MemoryCalendar(QTimeZone::utc()));
+    for (int i = 0; i < 10; ++i) {
+        Event::Ptr event(new Event);
+        event->setUid(QStringLiteral("event-%1").arg(i));
+        event->setDtStart(QDateTime(QDate(2019, 1, 1 + i), QTime(10, 0), tz));
+        event->setDtEnd(event->dtStart().addSecs(3600));
+        calendar->addEvent(event);
+    }
+
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.close();
+
+    ICalFormat format;
+    QVERIFY(format.save(calendar, file.fileName()));
+
+    QVERIFY(file.open());
+    const QByteArray saved = file.readAll();
+    file.close();
+    QCOMPARE(saved, format.toString(calendar).toUtf8());
+    QVERIFY(saved.startsWith("BEGIN:VCALENDAR\r\n"));
+    QVERIFY(saved.endsWith("END:VCALENDAR\r\n"));
+    QCOMPARE(saved.count("BEGIN:VTIMEZONE"), 1);
+    QVERIFY(saved.indexOf("BEGIN:VTIMEZONE") > saved.lastIndexOf("END:VEVENT"));
+
+    MemoryCalendar::Ptr loaded(new MemoryCalendar(QTimeZone::utc()));
+    QVERIFY(format.load(loaded, file.fileName()));
+    QCOMPARE(loaded->events().count(), 10);
+    const Event::List events = calendar->events();
+    for (const Event::Ptr &event : events) {
+        const Event::Ptr other = loaded->event(event->uid());
+        QVERIFY(other);
+        QCOMPARE(other->dtStart(), event->dtStart());
+    }
+}
+
+void ICalFormatTest::testSaveDeleted()
+{
+    MemoryCalendar::Ptr calendar(new MemoryCalendar(QTimeZone::utc()));
+    Todo::Ptr todo(new Todo);
+    todo->setUid(QStringLiteral("reused"));
+    QVERIFY(calendar->addTodo(todo));
+    QVERIFY(calendar->deleteTodo(todo));
+
+    // An event with the same uid does not bring the to-do back
+    Event::Ptr event(new Event);
+    event->setUid(QStringLiteral("reused"));
+    QVERIFY(calendar->addEvent(event));
+
+    ICalFormat format;
+    const QString deleted = format.toString(calendar, QString(), true);
+    QCOMPARE(deleted.count(QLatin1String("BEGIN:VTODO")), 1);
+    QVERIFY(!deleted.contains(QLatin1String("BEGIN:VEVENT")));
+}
+
+void ICalFormatTest::testLoadInParallel()
+{
+    const QTimeZone tz("America/New_York");
+    MemoryCalendar::Ptr calendar(new MemoryCalendar(QTimeZone::utc()));
+    for (int i = 0; i < 1000; ++i) {
+        Incidence::Ptr incidence;
+        if (i % 3 == 0) {
+            incidence = Todo::Ptr(new Todo);
+        } else {
+            incidence = Event::Ptr(new Event);
+        }
+        incidence->setUid(QStringLiteral("incidence-%1").arg(i));
+        incidence->setSummary(QStringLiteral("Summary %1").arg(i));
+        incidence->setDtStart(QDateTime(QDate(2019, 1, 1).addDays(i), QTime(9, 0), tz));
+        if (i % 10 == 0) {
+            incidence->recurrence()->setDaily(1);
+        }
+        calendar->addIncidence(incidence);
+    }
+
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.close();
+
+    ICalFormat format;
+    QVERIFY(format.save(calendar, file.fileName()));
+
+    MemoryCalendar::Ptr serial(new MemoryCalendar(QTimeZone::utc()));
+    QVERIFY(format.load(serial, file.fileName()));
+
+    format.setLoadThreadCount(4);
+    QCOMPARE(format.loadThreadCount(), 4);
+    MemoryCalendar::Ptr parallel(new MemoryCalendar(QTimeZone::utc()));
+    QVERIFY(format.load(parallel, file.fileName()));
+
+    QCOMPARE(parallel->incidences().count(), 1000);
+    QCOMPARE(parallel->todos().count(), serial->todos().count());
+    const Incidence::List incidences = serial->incidences();
+    for (const Incidence::Ptr &incidence : incidences) {
+        const Incidence::Ptr other = parallel->incidence(incidence->uid());
+        QVERIFY(other);
+        QCOMPARE(*other, *incidence);
+    }
+}
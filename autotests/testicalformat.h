@@ -33,6 +33,10 @@ private Q_SLOTS:
     void testVolatileProperties();
     void testCuType();
     void testAlarm();
+    void testLoadIncrementally();
+    void testSaveIncrementally();
+    void testSaveDeleted();
+    void testLoadInParallel();
 };
 
 #endif
@@ -21,6 +21,7 @@
 
 #include "testicaltimezones.h"
 #include "icaltimezones_p.h"
+#include "timezonetable_p.h"
 
 #include <QDateTime>
 
@@ -210,6 +211,126 @@ void ICalTimeZonesTest::parse()
     QCOMPARE(timezones.tzForTime(onDate, origTz).id(), expTz);
 }
 
+void ICalTimeZonesTest::parseRepeated()
+{
+    // The same definition under different TZIDs, and in separate calendars
+    QByteArray calText(calendarHeader);
+    calText += VTZ_Western;
+    calText += QByteArray(VTZ_Western).replace("TZID:Test-Dummy-Western", "TZID:Test-Dummy-Western-2");
+    calText += VTZ_other;
+    calText += calendarFooter;
+
+    for (int i = 0; i < 2; ++i) {
+        auto vcalendar = loadCALENDAR(calText.constData());
+
+        ICalTimeZoneCache timezones;
+        ICalTimeZoneParser parser(&timezones);
+        parser.parse(vcalendar);
+
+        icalcomponent_free(vcalendar);
+
+        QCOMPARE(timezones.tzForTime(QDateTime(), "Test-Dummy-Western").id(), QByteArray("America/Toronto"));
+        QCOMPARE(timezones.tzForTime(QDateTime(), "Test-Dummy-Western-2").id(), QByteArray("America/Toronto"));
+        QCOMPARE(timezones.tzForTime(QDateTime(), "Test-Dummy-Other").id(), QByteArray("UTC+03:00"));
+    }
+}
+
+void ICalTimeZonesTest::timeZoneCache()
+{
+    const QDateTime start(QDate(2019, 1, 1), QTime(0, 0, 0), Qt::UTC);
+    ICalTimeZone tz;
+    tz.id = "Test-Dummy-Overlap";
+    tz.qZone = QTimeZone("UTC+03:00");
+    tz.standard.utcOffset = 3 * 3600;
+    tz.standard.transitions << start << start.addDays(200);
+    tz.daylight.utcOffset = 5 * 3600;
+    tz.daylight.transitions << start.addDays(100) << start.addDays(200);
+
+    ICalTimeZoneCache timezones;
+    timezones.insert(tz.id, tz);
+    QCOMPARE(timezones.tzForTime(start.addDays(50), tz.id).id(), QByteArray("UTC+03:00"));
+    QCOMPARE(timezones.tzForTime(start.addDays(150), tz.id).id(), QByteArray("UTC+05:00"));
+    // The previous phase lasts until the transition
+    QCOMPARE(timezones.tzForTime(start.addDays(100), tz.id).id(), QByteArray("UTC+03:00"));
+    // Where both phases start at once, standard time wins
+    QCOMPARE(timezones.tzForTime(start.addDays(250), tz.id).id(), QByteArray("UTC+03:00"));
+
+    // Nothing is remembered of the TZID once cleared
+    timezones.clear();
+    QCOMPARE(timezones.tzForTime(start.addDays(150), tz.id), QTimeZone::systemTimeZone());
+    timezones.insert(tz.id, tz);
+    QCOMPARE(timezones.tzForTime(start.addDays(150), tz.id).id(), QByteArray("UTC+05:00"));
+}
+
+void ICalTimeZonesTest::timeZoneTable_data()
+{
+    QTest::addColumn<QByteArray>("tz");
+
+    QTest::newRow("Europe/Zurich") << QByteArray("Europe/Zurich");
+    QTest::newRow("America/Toronto") << QByteArray("America/Toronto");
+    // DST shifts by half an hour only
+    QTest::newRow("Australia/Lord_Howe") << QByteArray("Australia/Lord_Howe");
+    QTest::newRow("Asia/Kathmandu") << QByteArray("Asia/Kathmandu");
+    QTest::newRow("UTC+03:00") << QByteArray("UTC+03:00");
+    QTest::newRow("UTC") << QByteArray("UTC");
+}
+
+void ICalTimeZonesTest::timeZoneTable()
+{
+    QFETCH(QByteArray, tz);
+
+    const QTimeZone zone(tz);
+    QVERIFY(zone.isValid());
+    const TimeZoneTable::Ptr table = TimeZoneTable::forTimeZone(zone);
+    QCOMPARE(table->timeZone(), zone);
+    QCOMPARE(TimeZoneTable::forTimeZone(zone), table);
+
+    // UTC to local, every quarter of an hour over two years
+    const QDateTime end(QDate(2019, 1, 1), QTime(0, 0, 0), Qt::UTC);
+    for (QDateTime dt(QDate(2017, 1, 1), QTime(0, 0, 0), Qt::UTC); dt < end; dt = dt.addSecs(900)) {
+        const QDateTime local = dt.toTimeZone(zone);
+        QCOMPARE(table->offsetFromUtc(dt.toMSecsSinceEpoch()), local.offsetFromUtc());
+        QCOMPARE(table->localDate(dt), local.date());
+        QCOMPARE(table->localTime(dt), local.time());
+    }
+
+    // Local to UTC, including the times in the gaps and overlaps of DST changes
+    for (QDate date(2017, 1, 1); date < end.date(); date = date.addDays(1)) {
+        for (int minutes = 0; minutes < 24 * 60; minutes += 15) {
+            const QTime time(minutes / 60, minutes % 60);
+            const QDateTime expected(date, time, zone);
+            const QDateTime actual = table->dateTime(date, time);
+            QCOMPARE(actual.isValid(), expected.isValid());
+            if (expected.isValid()) {
+                QCOMPARE(actual.toMSecsSinceEpoch(), expected.toMSecsSinceEpoch());
+                QCOMPARE(actual.timeZone(), zone);
+                QCOMPARE(actual.date(), date);
+                QCOMPARE(actual.time(), time);
+            }
+        }
+    }
+}
+
+void ICalTimeZonesTest::timeZoneTableSharing()
+{
+    const QDateTime dt(QDate(2019, 6, 1), QTime(12, 0, 0), Qt::UTC);
+    QCOMPARE(TimeZoneTable::forTimeZone(dt.timeZone()), TimeZoneTable::forTimeZone(QTimeZone::utc()));
+
+    // Custom zones may share an id, but not their table
+    const QTimeZone first("Custom", 3600, QStringLiteral("Custom"), QStringLiteral("C"));
+    const QTimeZone second("Custom", 7200, QStringLiteral("Custom"), QStringLiteral("C"));
+    QCOMPARE(TimeZoneTable::forTimeZone(first), TimeZoneTable::forTimeZone(first));
+    QCOMPARE(TimeZoneTable::forTimeZone(first)->localTime(dt), QTime(13, 0, 0));
+    QCOMPARE(TimeZoneTable::forTimeZone(second)->localTime(dt), QTime(14, 0, 0));
+
+    TimeZoneTable::Ptr cached;
+    QCOMPARE(TimeZoneTable::forTimeZone(first, cached)->localTime(dt), QTime(13, 0, 0));
+    const TimeZoneTable::Ptr previous = cached;
+    QCOMPARE(TimeZoneTable::forTimeZone(first, cached), previous);
+    QCOMPARE(TimeZoneTable::forTimeZone(second, cached)->localTime(dt), QTime(14, 0, 0));
+    QCOMPARE(TimeZoneTable::forTimeZone(QTimeZone("Europe/Zurich"), cached)->localTime(dt), QTime(14, 0, 0));
+}
+
 void ICalTimeZonesTest::write()
 {
     auto vtimezone = ICalTimeZoneParser::vcaltimezoneFromQTimeZone(QTimeZone("Europe/Prague"),
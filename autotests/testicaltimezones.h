@@ -31,6 +31,11 @@ private Q_SLOTS:
     void initTestCase();
     void parse_data();
     void parse();
+    void parseRepeated();
+    void timeZoneCache();
+    void timeZoneTable_data();
+    void timeZoneTable();
+    void timeZoneTableSharing();
     void write();
 };
 
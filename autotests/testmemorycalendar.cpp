@@ -21,16 +21,58 @@
 
 #include "testmemorycalendar.h"
 #include "filestorage.h"
+#include "icalformat.h"
 #include "memorycalendar.h"
 
 #include <QDebug>
 
 #include <QTest>
 #include <QTimeZone>
+
+#include <algorithm>
 QTEST_MAIN(MemoryCalendarTest)
 
 using namespace KCalendarCore;
 
+// Hides the events of the "private" category
+class PublicCalendar : public MemoryCalendar
+{
+public:
+    PublicCalendar() : MemoryCalendar(QTimeZone::utc())
+    {
+        setDirectIncidenceIteration(false);
+    }
+
+    using MemoryCalendar::rawEvents;
+    Event::List rawEvents(EventSortField sortField = EventSortUnsorted,
+                          SortDirection sortDirection = SortDirectionAscending) const override
+    {
+        Event::List events = MemoryCalendar::rawEvents(sortField, sortDirection);
+        events.erase(std::remove_if(events.begin(), events.end(), [](const Event::Ptr &event) {
+            return event->categories().contains(QStringLiteral("private"));
+        }), events.end());
+        return events;
+    }
+};
+
+// Tags every incidence added to it
+class TaggingCalendar : public MemoryCalendar
+{
+public:
+    typedef QSharedPointer<TaggingCalendar> Ptr;
+
+    TaggingCalendar() : MemoryCalendar(QTimeZone::utc())
+    {
+        setDirectIncidenceInsertion(false);
+    }
+
+    bool addIncidence(const Incidence::Ptr &incidence) override
+    {
+        incidence->setCategories(QStringLiteral("tagged"));
+        return MemoryCalendar::addIncidence(incidence);
+    }
+};
+
 void MemoryCalendarTest::testValidity()
 {
     MemoryCalendar::Ptr cal(new MemoryCalendar(QTimeZone::utc()));
@@ -176,6 +218,349 @@ void MemoryCalendarTest::testRelationsCrash()
     cal->close();
 }
 
+void MemoryCalendarTest::testRelations()
+{
+    MemoryCalendar::Ptr cal(new MemoryCalendar(QTimeZone::utc()));
+
+    auto makeTodo = [](const QString &uid, const QString &parentUid) {
+        Todo::Ptr todo(new Todo());
+        todo->setUid(uid);
+        todo->setRelatedTo(parentUid);
+        return todo;
+    };
+    const Todo::Ptr root = makeTodo(QStringLiteral("root"), QString());
+    const Todo::Ptr child1 = makeTodo(QStringLiteral("child1"), QStringLiteral("root"));
+    const Todo::Ptr child2 = makeTodo(QStringLiteral("child2"), QStringLiteral("root"));
+    const Todo::Ptr grandchild = makeTodo(QStringLiteral("grandchild"), QStringLiteral("child1"));
+
+    // Children may come before their parents
+    QVERIFY(cal->addTodo(grandchild));
+    QVERIFY(cal->addTodo(child1));
+    QVERIFY(cal->addTodo(root));
+    QVERIFY(cal->addTodo(child2));
+
+    QCOMPARE(cal->relations(QStringLiteral("root")), Incidence::List() << child1 << child2);
+    QCOMPARE(cal->relations(QStringLiteral("child1")), Incidence::List() << grandchild);
+    QVERIFY(cal->relations(QStringLiteral("grandchild")).isEmpty());
+    QCOMPARE(cal->descendants(QStringLiteral("root")), Incidence::List() << child1 << child2 << grandchild);
+    QCOMPARE(cal->ancestorUids(QStringLiteral("grandchild")),
+             QStringList() << QStringLiteral("child1") << QStringLiteral("root"));
+    QVERIFY(cal->ancestorUids(QStringLiteral("root")).isEmpty());
+    QVERIFY(cal->isAncestorOf(root, grandchild));
+    QVERIFY(!cal->isAncestorOf(grandchild, root));
+    QVERIFY(!cal->isAncestorOf(child2, grandchild));
+
+    // Moving a to-do moves its subtree along
+    child1->setRelatedTo(QStringLiteral("child2"));
+    QCOMPARE(cal->relations(QStringLiteral("root")), Incidence::List() << child2);
+    QCOMPARE(cal->descendants(QStringLiteral("child2")), Incidence::List() << child1 << grandchild);
+    QVERIFY(cal->isAncestorOf(child2, grandchild));
+
+    // Loops are refused
+    root->setRelatedTo(QStringLiteral("grandchild"));
+    QVERIFY(root->relatedTo().isEmpty());
+    QVERIFY(cal->ancestorUids(QStringLiteral("root")).isEmpty());
+
+    // Children of a deleted to-do wait for it to come back
+    QVERIFY(cal->deleteTodo(child1));
+    QCOMPARE(cal->relations(QStringLiteral("child2")), Incidence::List());
+    QCOMPARE(cal->relations(QStringLiteral("child1")), Incidence::List() << grandchild);
+    QCOMPARE(cal->ancestorUids(QStringLiteral("grandchild")), QStringList());
+    QVERIFY(cal->addTodo(child1));
+    QCOMPARE(cal->descendants(QStringLiteral("root")), Incidence::List() << child2 << child1 << grandchild);
+
+    cal->close();
+    QVERIFY(cal->relations(QStringLiteral("root")).isEmpty());
+}
+
+void MemoryCalendarTest::testSchedulingID()
+{
+    MemoryCalendar::Ptr cal(new MemoryCalendar(QTimeZone::utc()));
+
+    Event::Ptr event(new Event());
+    event->setUid(QStringLiteral("event"));
+    event->setDtStart(QDateTime(QDate(2019, 10, 1), QTime(10, 0, 0), Qt::UTC));
+    Todo::Ptr todo(new Todo());
+    todo->setUid(QStringLiteral("todo"));
+    todo->setSchedulingID(QStringLiteral("sid"));
+    QVERIFY(cal->addEvent(event));
+    QVERIFY(cal->addTodo(todo));
+
+    // Without a scheduling ID of its own, an incidence is found by its uid
+    QCOMPARE(cal->incidenceFromSchedulingID(QStringLiteral("event")), Incidence::Ptr(event));
+    QCOMPARE(cal->incidenceFromSchedulingID(QStringLiteral("sid")), Incidence::Ptr(todo));
+    QVERIFY(!cal->incidenceFromSchedulingID(QStringLiteral("todo")));
+
+    // Changing the scheduling ID is not an update of the incidence
+    cal->setModified(false);
+    const QDateTime lastModified = event->lastModified();
+    event->setSchedulingID(QStringLiteral("sid"));
+    QVERIFY(!cal->isModified());
+    QCOMPARE(event->lastModified(), lastModified);
+    QVERIFY(!cal->incidenceFromSchedulingID(QStringLiteral("event")));
+    Incidence::List incidences = cal->incidencesFromSchedulingID(QStringLiteral("sid"));
+    QCOMPARE(incidences.count(), 2);
+    QVERIFY(incidences.contains(event));
+    QVERIFY(incidences.contains(todo));
+
+    todo->setSchedulingID(QString());
+    QCOMPARE(cal->incidencesFromSchedulingID(QStringLiteral("sid")), Incidence::List() << event);
+    QCOMPARE(cal->incidenceFromSchedulingID(QStringLiteral("todo")), Incidence::Ptr(todo));
+
+    QVERIFY(cal->deleteEvent(event));
+    QVERIFY(cal->incidencesFromSchedulingID(QStringLiteral("sid")).isEmpty());
+
+    cal->close();
+    QVERIFY(!cal->incidenceFromSchedulingID(QStringLiteral("todo")));
+}
+
+void MemoryCalendarTest::testDuplicates()
+{
+    MemoryCalendar::Ptr cal(new MemoryCalendar(QTimeZone::utc()));
+    QVERIFY(cal->addNotebook(QStringLiteral("notebook"), true));
+
+    const QDateTime start(QDate(2019, 10, 1), QTime(10, 0, 0), Qt::UTC);
+    auto makeEvent = [&start](const QString &uid, const QString &summary) {
+        Event::Ptr event(new Event());
+        event->setUid(uid);
+        event->setDtStart(start);
+        event->setSummary(summary);
+        return event;
+    };
+    const Event::Ptr event1 = makeEvent(QStringLiteral("1"), QStringLiteral("Meeting"));
+    const Event::Ptr event2 = makeEvent(QStringLiteral("2"), QStringLiteral("Lunch"));
+    for (const Event::Ptr &event : {event1, event2}) {
+        QVERIFY(cal->addEvent(event));
+        QVERIFY(cal->setNotebook(event, QStringLiteral("notebook")));
+    }
+
+    const Event::Ptr imported1 = makeEvent(QStringLiteral("3"), QStringLiteral("Meeting"));
+    const Event::Ptr imported2 = makeEvent(QStringLiteral("4"), QStringLiteral("Meeting"));
+    imported2->setDtStart(start.addSecs(3600));
+    QCOMPARE(cal->duplicates(imported1), Incidence::List() << event1);
+    QVERIFY(cal->duplicates(imported2).isEmpty());
+
+    // Changes of the start or summary are followed
+    event2->setSummary(QStringLiteral("Meeting"));
+    event1->setDtStart(start.addSecs(3600));
+    const QVector<Incidence::List> duplicates =
+        cal->duplicates(Incidence::List() << imported1 << imported2 << Incidence::Ptr());
+    QCOMPARE(duplicates.count(), 3);
+    QCOMPARE(duplicates[0], Incidence::List() << event2);
+    QCOMPARE(duplicates[1], Incidence::List() << event1);
+    QVERIFY(duplicates[2].isEmpty());
+
+    cal->clearNotebookAssociations();
+    QVERIFY(cal->duplicates(imported1).isEmpty());
+    cal->close();
+}
+
+void MemoryCalendarTest::testForEachIncidence()
+{
+    MemoryCalendar::Ptr cal(new MemoryCalendar(QTimeZone::utc()));
+    for (int i = 0; i < 3; ++i) {
+        Event::Ptr event(new Event());
+        event->setCategories(QStringList() << QStringLiteral("event") << QString::number(i));
+        QVERIFY(cal->addEvent(event));
+    }
+    for (int i = 0; i < 2; ++i) {
+        Todo::Ptr todo(new Todo());
+        todo->setCategories(QStringLiteral("todo"));
+        QVERIFY(cal->addTodo(todo));
+    }
+    QVERIFY(cal->addJournal(Journal::Ptr(new Journal())));
+
+    QSet<Incidence::Ptr> all;
+    cal->forEachIncidence([&all](const Incidence::Ptr &incidence) {
+        all.insert(incidence);
+    });
+    QCOMPARE(all.count(), 6);
+    const Incidence::List rawIncidences = cal->rawIncidences();
+    for (const Incidence::Ptr &incidence : rawIncidences) {
+        QVERIFY(all.contains(incidence));
+    }
+
+    for (auto type : { Incidence::TypeEvent, Incidence::TypeTodo, Incidence::TypeJournal }) {
+        int count = 0;
+        cal->forEachIncidence(type, [&count, type](const Incidence::Ptr &incidence) {
+            QCOMPARE(incidence->type(), type);
+            ++count;
+        });
+        QCOMPARE(count, type == Incidence::TypeEvent ? 3 : type == Incidence::TypeTodo ? 2 : 1);
+    }
+
+    QStringList categories = cal->categories();
+    categories.sort();
+    QCOMPARE(categories, QStringList() << QStringLiteral("0") << QStringLiteral("1") << QStringLiteral("2")
+             << QStringLiteral("event") << QStringLiteral("todo"));
+    cal->close();
+
+    // Subclasses reimplementing the lists are honoured
+    PublicCalendar publicCal;
+    Event::Ptr event(new Event());
+    event->setCategories(QStringLiteral("private"));
+    QVERIFY(publicCal.addEvent(event));
+    QVERIFY(publicCal.addEvent(Event::Ptr(new Event())));
+    int count = 0;
+    publicCal.forEachIncidence([&count](const Incidence::Ptr &incidence) {
+        QVERIFY(!incidence->categories().contains(QStringLiteral("private")));
+        ++count;
+    });
+    QCOMPARE(count, 1);
+    QVERIFY(publicCal.categories().isEmpty());
+    publicCal.close();
+}
+
+void MemoryCalendarTest::testAddIncidences()
+{
+    MemoryCalendar::Ptr cal(new MemoryCalendar(QTimeZone::utc()));
+    const QDateTime start(QDate(2019, 6, 1), QTime(10, 0), QTimeZone::utc());
+
+    // The child comes before its parent
+    Todo::Ptr child(new Todo());
+    child->setUid(QStringLiteral("child"));
+    child->setRelatedTo(QStringLiteral("parent"));
+    child->setDtDue(start);
+    Todo::Ptr parent(new Todo());
+    parent->setUid(QStringLiteral("parent"));
+    Event::Ptr event(new Event());
+    event->setUid(QStringLiteral("event"));
+    event->setDtStart(start);
+    event->setDtEnd(start.addSecs(3600));
+    Journal::Ptr journal(new Journal());
+    journal->setUid(QStringLiteral("journal"));
+    journal->setDtStart(start);
+
+    QVERIFY(cal->addIncidences(Incidence::List() << child << parent << event << journal));
+    QVERIFY(cal->isModified());
+    QCOMPARE(cal->incidence(QStringLiteral("child")), Incidence::Ptr(child));
+    QCOMPARE(cal->rawEventsForDate(start.date()), Event::List() << event);
+    QCOMPARE(cal->rawEvents(start.date(), start.date()), Event::List() << event);
+    QCOMPARE(cal->rawTodosForDate(start.date()), Todo::List() << child);
+    QCOMPARE(cal->rawJournalsForDate(start.date()), Journal::List() << journal);
+    QCOMPARE(cal->relations(QStringLiteral("parent")), Incidence::List() << child);
+    QCOMPARE(cal->ancestorUids(QStringLiteral("child")), QStringList() << QStringLiteral("parent"));
+
+    // Updates reach the calendar
+    event->setDtStart(start.addDays(1));
+    event->setDtEnd(start.addDays(1).addSecs(3600));
+    QVERIFY(cal->rawEventsForDate(start.date()).isEmpty());
+    QCOMPARE(cal->rawEventsForDate(start.date().addDays(1)), Event::List() << event);
+
+    QVERIFY(!cal->addIncidences(Incidence::List() << Incidence::Ptr()));
+    cal->close();
+
+    // Subclasses get the incidences through their own addIncidence(), also
+    // when loading a calendar
+    TaggingCalendar::Ptr tagging(new TaggingCalendar);
+    QVERIFY(tagging->addIncidences(Incidence::List() << Event::Ptr(new Event())));
+    QCOMPARE(tagging->rawEvents().first()->categories(), QStringList(QStringLiteral("tagged")));
+
+    ICalFormat format;
+    Event::Ptr loaded(new Event());
+    loaded->setUid(QStringLiteral("loaded"));
+    loaded->setDtStart(start);
+    QVERIFY(format.fromString(tagging, format.toICalString(loaded)));
+    QCOMPARE(tagging->event(QStringLiteral("loaded"))->categories(), QStringList(QStringLiteral("tagged")));
+    tagging->close();
+}
+
+void MemoryCalendarTest::testAlarmIndex()
+{
+    MemoryCalendar::Ptr cal(new MemoryCalendar(QTimeZone::utc()));
+    const QDateTime start(QDate(2019, 6, 1), QTime(10, 0), QTimeZone::utc());
+
+    Event::Ptr event(new Event());
+    event->setDtStart(start);
+    event->setDtEnd(start.addSecs(3600));
+    Alarm::Ptr eventAlarm = event->newAlarm();
+    eventAlarm->setStartOffset(Duration(-15 * 60));
+    eventAlarm->setEnabled(true);
+    QVERIFY(cal->addEvent(event));
+
+    Event::Ptr daily(new Event());
+    daily->setDtStart(start.addSecs(2 * 3600));
+    daily->setDtEnd(start.addSecs(3 * 3600));
+    daily->recurrence()->setDaily(1);
+    daily->recurrence()->setDuration(3);
+    Alarm::Ptr dailyAlarm = daily->newAlarm();
+    dailyAlarm->setStartOffset(Duration(0));
+    dailyAlarm->setEnabled(true);
+    QVERIFY(cal->addEvent(daily));
+
+    Todo::Ptr todo(new Todo());
+    todo->setDtDue(start.addDays(-1));
+    Alarm::Ptr todoAlarm = todo->newAlarm();
+    todoAlarm->setEndOffset(Duration(0));
+    todoAlarm->setEnabled(true);
+    QVERIFY(cal->addTodo(todo));
+
+    QCOMPARE(cal->nextAlarmTime(), start.addDays(-1));
+    // Completed to-dos have no alarms due
+    todo->setCompleted(true);
+    QCOMPARE(cal->nextAlarmTime(), start.addSecs(-15 * 60));
+
+    QCOMPARE(cal->alarmsDue(start.addSecs(2 * 3600)), Alarm::List() << eventAlarm << dailyAlarm);
+    QCOMPARE(cal->nextAlarmTime(), start.addDays(1).addSecs(2 * 3600));
+    QVERIFY(cal->alarmsDue(start.addSecs(2 * 3600)).isEmpty());
+
+    // A changed incidence is due at its new time
+    event->setDtStart(start.addDays(2));
+    event->setDtEnd(start.addDays(2).addSecs(3600));
+    QCOMPARE(cal->alarmsDue(start.addDays(1).addSecs(12 * 3600)), Alarm::List() << dailyAlarm);
+    QCOMPARE(cal->nextAlarmTime(), start.addDays(2).addSecs(-15 * 60));
+
+    // A deleted one is not due any more
+    QVERIFY(cal->deleteEvent(event));
+    QCOMPARE(cal->nextAlarmTime(), start.addDays(2).addSecs(2 * 3600));
+
+    QCOMPARE(cal->alarmsDue(start.addDays(10)), Alarm::List() << dailyAlarm);
+    QVERIFY(!cal->nextAlarmTime().isValid());
+    cal->close();
+}
+
+void MemoryCalendarTest::testAlarmOccurrences()
+{
+    MemoryCalendar::Ptr cal(new MemoryCalendar(QTimeZone::utc()));
+    const QDateTime start(QDate(2019, 6, 1), QTime(10, 0), QTimeZone::utc());
+
+    Event::Ptr daily(new Event());
+    daily->setDtStart(start);
+    daily->setDtEnd(start.addSecs(3600));
+    daily->recurrence()->setDaily(1);
+    Alarm::Ptr dailyAlarm = daily->newAlarm();
+    dailyAlarm->setStartOffset(Duration(-15 * 60));
+    dailyAlarm->setEnabled(true);
+    QVERIFY(cal->addEvent(daily));
+
+    Event::Ptr event(new Event());
+    event->setDtStart(start.addDays(2).addSecs(-2 * 3600));
+    event->setDtEnd(start.addDays(2));
+    Alarm::Ptr eventAlarm = event->newAlarm();
+    eventAlarm->setStartOffset(Duration(0));
+    eventAlarm->setEnabled(true);
+    QVERIFY(cal->addEvent(event));
+
+    Alarm::Ptr disabledAlarm = event->newAlarm();
+    disabledAlarm->setStartOffset(Duration(0));
+    disabledAlarm->setEnabled(false);
+
+    const QDateTime from(QDate(2019, 6, 2), QTime(0, 0), QTimeZone::utc());
+    const QDateTime to(QDate(2019, 6, 3), QTime(23, 59, 59), QTimeZone::utc());
+    const AlarmOccurrence::List occurrences = cal->alarmOccurrences(from, to);
+    QCOMPARE(occurrences.count(), 2);
+    QCOMPARE(occurrences.at(0), AlarmOccurrence(dailyAlarm, daily, start.addDays(1), start.addDays(1).addSecs(-15 * 60)));
+    QCOMPARE(occurrences.at(1), AlarmOccurrence(eventAlarm, event, QDateTime(), start.addDays(2).addSecs(-2 * 3600)));
+
+    // The same alarms as alarms() returns
+    const Alarm::List alarms = cal->alarms(from, to);
+    QCOMPARE(alarms.count(), occurrences.count());
+    for (const AlarmOccurrence &occurrence : occurrences) {
+        QVERIFY(alarms.contains(occurrence.alarm()));
+    }
+    cal->close();
+}
+
 void MemoryCalendarTest::testRecurrenceExceptions()
 {
     MemoryCalendar::Ptr cal(new MemoryCalendar(QTimeZone::utc()));
@@ -272,3 +657,117 @@ void MemoryCalendarTest::testChangeRecurId()
     QVERIFY(exception->summary() == QLatin1String("exception"));
     QVERIFY(main->summary() == event1->summary());
 }
+
+void MemoryCalendarTest::testRawEventsInRange()
+{
+    MemoryCalendar::Ptr cal(new MemoryCalendar(QTimeZone::utc()));
+    const QDateTime start(QDate(2019, 6, 1), QTime(10, 0, 0), Qt::UTC);
+
+    // One single-hour event per day for 100 days
+    for (int i = 0; i < 100; ++i) {
+        Event::Ptr event(new Event());
+        event->setUid(QString::number(i));
+        event->setDtStart(start.addDays(i));
+        event->setDtEnd(start.addDays(i).addSecs(3600));
+        QVERIFY(cal->addEvent(event));
+    }
+
+    // A long event spanning most of the range
+    Event::Ptr longEvent(new Event());
+    longEvent->setUid(QStringLiteral("long"));
+    longEvent->setDtStart(start.addDays(-10));
+    longEvent->setDtEnd(start.addDays(80));
+    QVERIFY(cal->addEvent(longEvent));
+
+    // A recurring event, which is not part of the interval index
+    Event::Ptr recurring(new Event());
+    recurring->setUid(QStringLiteral("recurring"));
+    recurring->setDtStart(start);
+    recurring->setDtEnd(start.addSecs(3600));
+    recurring->recurrence()->setWeekly(1);
+    QVERIFY(cal->addEvent(recurring));
+
+    Event::List events = cal->rawEvents(QDate(2019, 6, 10), QDate(2019, 6, 12));
+    QCOMPARE(events.count(), 5);
+    QVERIFY(events.contains(longEvent));
+    QVERIFY(events.contains(recurring));
+
+    events = cal->rawEvents(QDate(2019, 6, 10), QDate(2019, 6, 12), QTimeZone::utc(), true);
+    QCOMPARE(events.count(), 3);
+    QVERIFY(!events.contains(longEvent));
+
+    // Moving an event must update the index
+    Event::Ptr moved = cal->event(QStringLiteral("50"));
+    moved->setDtStart(start.addDays(10));
+    moved->setDtEnd(start.addDays(10).addSecs(3600));
+    events = cal->rawEvents(QDate(2019, 6, 10), QDate(2019, 6, 12));
+    QCOMPARE(events.count(), 6);
+    QVERIFY(events.contains(moved));
+
+    // Making an event recurring moves it out of the interval index
+    Event::Ptr madeRecurring = cal->event(QStringLiteral("0"));
+    madeRecurring->recurrence()->setDaily(1);
+    events = cal->rawEvents(QDate(2019, 6, 10), QDate(2019, 6, 12));
+    QCOMPARE(events.count(), 7);
+    QVERIFY(events.contains(madeRecurring));
+
+    QVERIFY(cal->deleteEvent(longEvent));
+    events = cal->rawEvents(QDate(2019, 6, 10), QDate(2019, 6, 12));
+    QCOMPARE(events.count(), 6);
+    QVERIFY(!events.contains(longEvent));
+
+    events = cal->rawEventsForDate(QDate(2019, 6, 20));
+    QVERIFY(!events.contains(longEvent));
+    QCOMPARE(events.count(), 2);
+
+    cal->close();
+    QVERIFY(cal->rawEvents(QDate(2019, 6, 10), QDate(2019, 6, 12)).isEmpty());
+}
+
+void MemoryCalendarTest::testRawEventsRecurrenceSpan()
+{
+    MemoryCalendar::Ptr cal(new MemoryCalendar(QTimeZone::utc()));
+    const QDateTime start(QDate(2019, 1, 7), QTime(9, 0, 0), Qt::UTC);
+
+    // Daily for ten days
+    Event::Ptr finite(new Event());
+    finite->setUid(QStringLiteral("finite"));
+    finite->setDtStart(start);
+    finite->setDtEnd(start.addSecs(1800));
+    finite->recurrence()->setDaily(1);
+    finite->recurrence()->setDuration(10);
+    QVERIFY(cal->addEvent(finite));
+
+    // Weekly, never ending
+    Event::Ptr infinite(new Event());
+    infinite->setUid(QStringLiteral("infinite"));
+    infinite->setDtStart(start);
+    infinite->setDtEnd(start.addSecs(1800));
+    infinite->recurrence()->setWeekly(1);
+    QVERIFY(cal->addEvent(infinite));
+
+    Event::List events = cal->rawEvents(QDate(2019, 1, 10), QDate(2019, 1, 12));
+    QCOMPARE(events.count(), 2);
+    QCOMPARE(cal->rawEventsForDate(QDate(2019, 1, 14)).count(), 2);
+
+    // The finite series is over by then
+    events = cal->rawEvents(QDate(2019, 3, 1), QDate(2019, 3, 31));
+    QCOMPARE(events.count(), 1);
+    QCOMPARE(events.first(), infinite);
+    QCOMPARE(cal->rawEventsForDate(QDate(2019, 3, 4)).count(), 1);
+
+    // Extending the series through its recurrence must refresh the index
+    finite->recurrence()->setDuration(-1);
+    QCOMPARE(cal->rawEvents(QDate(2019, 3, 1), QDate(2019, 3, 31)).count(), 2);
+    QCOMPARE(cal->rawEventsForDate(QDate(2019, 3, 5)).count(), 1);
+    QCOMPARE(cal->rawEventsForDate(QDate(2019, 3, 4)).count(), 2);
+
+    // ... and so must ending it
+    finite->recurrence()->setEndDate(QDate(2019, 1, 20));
+    QCOMPARE(cal->rawEvents(QDate(2019, 3, 1), QDate(2019, 3, 31)).count(), 1);
+    QCOMPARE(cal->rawEventsForDate(QDate(2019, 1, 20)).count(), 1);
+    QCOMPARE(cal->rawEventsForDate(QDate(2019, 1, 21)).count(), 1);
+
+    QVERIFY(cal->deleteEvent(infinite));
+    QVERIFY(cal->rawEvents(QDate(2019, 3, 1), QDate(2019, 3, 31)).isEmpty());
+}
@@ -32,8 +32,17 @@ private Q_SLOTS:
     void testEvents();
     void testIncidences();
     void testRelationsCrash();
+    void testRelations();
+    void testSchedulingID();
+    void testDuplicates();
+    void testForEachIncidence();
+    void testAddIncidences();
+    void testAlarmIndex();
+    void testAlarmOccurrences();
     void testRecurrenceExceptions();
     void testChangeRecurId();
+    void testRawEventsInRange();
+    void testRawEventsRecurrenceSpan();
 };
 
 #endif
@@ -296,3 +296,70 @@ void TestOccurrenceIterator::testJournals()
     KCalendarCore::OccurrenceIterator rIt2(calendar, tomorrow, tomorrow.addDays(1));
     QVERIFY(!rIt2.hasNext());
 }
+
+void TestOccurrenceIterator::testLazyIteration()
+{
+    KCalendarCore::MemoryCalendar calendar(QTimeZone::utc());
+
+    QDateTime start(QDate(2013, 03, 10), QTime(0, 0, 0), Qt::UTC);
+    QDateTime actualEnd(QDate(2013, 03, 13), QTime(23, 0, 0), Qt::UTC);
+
+    KCalendarCore::Event::Ptr event1(new KCalendarCore::Event());
+    event1->setUid(QStringLiteral("event1"));
+    event1->setSummary(QStringLiteral("event1"));
+    event1->setDtStart(QDateTime(QDate(2013, 03, 10), QTime(10, 0, 0), Qt::UTC));
+    event1->recurrence()->setDaily(1);
+    calendar.addEvent(event1);
+
+    KCalendarCore::Event::Ptr event2(new KCalendarCore::Event());
+    event2->setUid(QStringLiteral("event2"));
+    event2->setSummary(QStringLiteral("event2"));
+    event2->setDtStart(QDateTime(QDate(2013, 03, 10), QTime(8, 0, 0), Qt::UTC));
+    event2->recurrence()->setDaily(1);
+    event2->recurrence()->setDuration(3);
+    calendar.addEvent(event2);
+
+    KCalendarCore::Event::Ptr single(new KCalendarCore::Event());
+    single->setUid(QStringLiteral("single"));
+    single->setSummary(QStringLiteral("single"));
+    single->setDtStart(QDateTime(QDate(2013, 03, 11), QTime(9, 0, 0), Qt::UTC));
+    calendar.addEvent(single);
+
+    // Moves the occurrence of March 12th to the day before
+    KCalendarCore::Event::Ptr exception(new KCalendarCore::Event());
+    exception->setUid(event1->uid());
+    exception->setSummary(QStringLiteral("exception"));
+    exception->setRecurrenceId(QDateTime(QDate(2013, 03, 12), QTime(10, 0, 0), Qt::UTC));
+    exception->setDtStart(QDateTime(QDate(2013, 03, 11), QTime(7, 0, 0), Qt::UTC));
+    calendar.addEvent(exception);
+
+    const QList<QPair<QDateTime, QString> > expected = {
+        { QDateTime(QDate(2013, 03, 10), QTime(8, 0, 0), Qt::UTC), QStringLiteral("event2") },
+        { QDateTime(QDate(2013, 03, 10), QTime(10, 0, 0), Qt::UTC), QStringLiteral("event1") },
+        { QDateTime(QDate(2013, 03, 11), QTime(7, 0, 0), Qt::UTC), QStringLiteral("exception") },
+        { QDateTime(QDate(2013, 03, 11), QTime(8, 0, 0), Qt::UTC), QStringLiteral("event2") },
+        { QDateTime(QDate(2013, 03, 11), QTime(9, 0, 0), Qt::UTC), QStringLiteral("single") },
+        { QDateTime(QDate(2013, 03, 11), QTime(10, 0, 0), Qt::UTC), QStringLiteral("event1") },
+        { QDateTime(QDate(2013, 03, 12), QTime(8, 0, 0), Qt::UTC), QStringLiteral("event2") },
+        { QDateTime(QDate(2013, 03, 13), QTime(10, 0, 0), Qt::UTC), QStringLiteral("event1") },
+    };
+
+    QList<QPair<QDateTime, QString> > lazy;
+    KCalendarCore::OccurrenceIterator rIt(calendar, start, actualEnd,
+                                          KCalendarCore::OccurrenceIterator::Lazy);
+    while (rIt.hasNext()) {
+        rIt.next();
+        lazy.append(qMakePair(rIt.occurrenceStartDate(), rIt.incidence()->summary()));
+    }
+    QCOMPARE(lazy, expected);
+
+    // Both modes return the same occurrences
+    QList<QPair<QDateTime, QString> > eager;
+    KCalendarCore::OccurrenceIterator eIt(calendar, start, actualEnd);
+    while (eIt.hasNext()) {
+        eIt.next();
+        eager.append(qMakePair(eIt.occurrenceStartDate(), eIt.incidence()->summary()));
+    }
+    std::sort(eager.begin(), eager.end());
+    QCOMPARE(eager, expected);
+}
@@ -0,0 +1,202 @@
+/*
+  This file is part of the kcalcore library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with this library; see the file COPYING.LIB.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+#include "testsnapshotformat.h"
+#include "event.h"
+#include "exceptions.h"
+#include "icalformat.h"
+#include "journal.h"
+#include "memorycalendar.h"
+#include "snapshotformat.h"
+#include "todo.h"
+
+#include <QTemporaryDir>
+#include <QTest>
+#include <QTimeZone>
+
+QTEST_MAIN(SnapshotFormatTest)
+
+using namespace KCalendarCore;
+
+void SnapshotFormatTest::testRoundTrip()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QStringLiteral("calendar.snapshot"));
+
+    const QTimeZone tz("Europe/Berlin");
+    MemoryCalendar::Ptr calendar(new MemoryCalendar(QTimeZone::utc()));
+    calendar->setNonKDECustomProperty("X-WR-CALNAME", QStringLiteral("Snapshot"));
+    for (int i = 0; i < 10; ++i) {
+        Event::Ptr event(new Event);
+        event->setUid(QStringLiteral("event-%1").arg(i));
+        event->setSummary(QStringLiteral("Event %1").arg(i));
+        event->setDtStart(QDateTime(QDate(2019, 3, 1).addDays(i), QTime(10, 0), tz));
+        event->setDtEnd(event->dtStart().addSecs(1800));
+        if (i == 0) {
+            event->recurrence()->setWeekly(1);
+            event->recurrence()->addExDate(QDate(2019, 3, 8));
+        }
+        calendar->addEvent(event);
+    }
+
+    Todo::Ptr todo(new Todo);
+    todo->setUid(QStringLiteral("todo"));
+    todo->setDtDue(QDateTime(QDate(2019, 4, 1), QTime(12, 0), Qt::UTC));
+    Alarm::Ptr alarm = todo->newAlarm();
+    alarm->setType(Alarm::Display);
+    alarm->setStartOffset(Duration(-3600));
+    calendar->addTodo(todo);
+
+    Journal::Ptr journal(new Journal);
+    journal->setUid(QStringLiteral("journal"));
+    journal->setDtStart(QDateTime(QDate(2019, 4, 2), {}));
+    journal->setAllDay(true);
+    calendar->addJournal(journal);
+
+    SnapshotFormat format;
+    QVERIFY(format.save(calendar, fileName));
+
+    MemoryCalendar::Ptr loaded(new MemoryCalendar(QTimeZone::utc()));
+    QVERIFY(format.load(loaded, fileName));
+    QCOMPARE(loaded->nonKDECustomProperty("X-WR-CALNAME"), QStringLiteral("Snapshot"));
+
+    const Incidence::List incidences = calendar->rawIncidences();
+    QCOMPARE(loaded->rawIncidences().count(), incidences.count());
+    for (const Incidence::Ptr &incidence : incidences) {
+        const Incidence::Ptr other = loaded->incidence(incidence->uid());
+        QVERIFY(other);
+        QCOMPARE(*other, *incidence);
+    }
+
+    // The string variants carry the same data
+    MemoryCalendar::Ptr fromString(new MemoryCalendar(QTimeZone::utc()));
+    QVERIFY(format.fromString(fromString, format.toString(calendar)));
+    QCOMPARE(fromString->rawIncidences().count(), incidences.count());
+}
+
+void SnapshotFormatTest::testDeleted()
+{
+    MemoryCalendar::Ptr calendar(new MemoryCalendar(QTimeZone::utc()));
+    Todo::Ptr todo(new Todo);
+    todo->setUid(QStringLiteral("reused"));
+    QVERIFY(calendar->addTodo(todo));
+    QVERIFY(calendar->deleteTodo(todo));
+
+    // An event with the same uid does not bring the to-do back
+    Event::Ptr event(new Event);
+    event->setUid(QStringLiteral("reused"));
+    QVERIFY(calendar->addEvent(event));
+
+    SnapshotFormat format;
+    MemoryCalendar::Ptr loaded(new MemoryCalendar(QTimeZone::utc()));
+    QVERIFY(format.fromString(loaded, format.toString(calendar, QString(), true), true));
+    QCOMPARE(loaded->deletedTodos().count(), 1);
+    QVERIFY(loaded->deletedEvents().isEmpty());
+}
+
+void SnapshotFormatTest::testCorruption()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QStringLiteral("calendar.snapshot"));
+
+    MemoryCalendar::Ptr calendar(new MemoryCalendar(QTimeZone::utc()));
+    for (int i = 0; i < 3; ++i) {
+        Event::Ptr event(new Event);
+        event->setUid(QStringLiteral("event-%1").arg(i));
+        event->setDtStart(QDateTime(QDate(2019, 3, 1).addDays(i), QTime(10, 0), Qt::UTC));
+        calendar->addEvent(event);
+    }
+
+    SnapshotFormat format;
+    QVERIFY(format.save(calendar, fileName));
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QByteArray data = file.readAll();
+    data[data.size() / 2] = ~data[data.size() / 2];
+    QVERIFY(file.seek(0));
+    file.write(data);
+    file.close();
+
+    MemoryCalendar::Ptr loaded(new MemoryCalendar(QTimeZone::utc()));
+    QVERIFY(!format.load(loaded, fileName));
+    QVERIFY(format.exception());
+    QCOMPARE(format.exception()->code(), Exception::ParseErrorKcal);
+    QVERIFY(loaded->rawIncidences().isEmpty());
+
+    QVERIFY(!format.load(loaded, dir.filePath(QStringLiteral("missing.snapshot"))));
+    QCOMPARE(format.exception()->code(), Exception::LoadError);
+}
+
+void SnapshotFormatTest::testStaleSnapshot()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString sourceName = dir.filePath(QStringLiteral("calendar.ics"));
+    const QString fileName = dir.filePath(QStringLiteral("calendar.snapshot"));
+
+    MemoryCalendar::Ptr calendar(new MemoryCalendar(QTimeZone::utc()));
+    for (int i = 0; i < 3; ++i) {
+        Event::Ptr event(new Event);
+        event->setUid(QStringLiteral("event-%1").arg(i));
+        event->setDtStart(QDateTime(QDate(2019, 3, 1).addDays(i), QTime(10, 0), Qt::UTC));
+        calendar->addEvent(event);
+    }
+    Todo::Ptr todo(new Todo);
+    todo->setUid(QStringLiteral("todo"));
+    calendar->addTodo(todo);
+    Journal::Ptr journal(new Journal);
+    journal->setUid(QStringLiteral("journal"));
+    calendar->addJournal(journal);
+
+    ICalFormat iCal;
+    QVERIFY(iCal.save(calendar, sourceName));
+
+    SnapshotFormat format;
+    format.setSourceFileName(sourceName);
+    QCOMPARE(format.sourceFileName(), sourceName);
+
+    // No snapshot yet: the source is loaded and the snapshot written
+    MemoryCalendar::Ptr loaded(new MemoryCalendar(QTimeZone::utc()));
+    QVERIFY(format.load(loaded, fileName));
+    QCOMPARE(loaded->rawEvents().count(), 3);
+    QVERIFY(QFile::exists(fileName));
+
+    // The source changes, so the snapshot is stale and gets replaced
+    for (int i = 3; i < 5; ++i) {
+        Event::Ptr event(new Event);
+        event->setUid(QStringLiteral("event-%1").arg(i));
+        event->setDtStart(QDateTime(QDate(2019, 3, 1).addDays(i), QTime(10, 0), Qt::UTC));
+        calendar->addEvent(event);
+    }
+    QVERIFY(iCal.save(calendar, sourceName));
+    loaded.reset(new MemoryCalendar(QTimeZone::utc()));
+    QVERIFY(format.load(loaded, fileName));
+    QCOMPARE(loaded->rawEvents().count(), 5);
+
+    // The updated snapshot is complete on its own
+    SnapshotFormat standalone;
+    loaded.reset(new MemoryCalendar(QTimeZone::utc()));
+    QVERIFY(standalone.load(loaded, fileName));
+    QCOMPARE(loaded->rawEvents().count(), 5);
+    QCOMPARE(loaded->rawTodos().count(), 1);
+    QCOMPARE(loaded->rawJournals().count(), 1);
+}
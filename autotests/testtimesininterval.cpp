@@ -21,8 +21,11 @@
 */
 #include "testtimesininterval.h"
 #include "event.h"
+#include "icalformat.h"
 
+#include <QBitArray>
 #include <QDebug>
+#include <QTimeZone>
 
 #include <QTest>
 QTEST_MAIN(TimesInIntervalTest)
@@ -155,3 +158,166 @@ void TimesInIntervalTest::testSubDailyRecurrenceIntervalLimits()
     }
     QCOMPARE(expectedEventOccurrences.size(), 0);
 }
+
+//Test that repeated and overlapping queries of an endless rule give stable results,
+//also after the rule changed
+void TimesInIntervalTest::testRepeatedQueries()
+{
+    const QDateTime start(QDate(2013, 1, 7), QTime(9, 0, 0), Qt::UTC);
+
+    KCalendarCore::Event::Ptr event(new KCalendarCore::Event());
+    event->setUid(QStringLiteral("event"));
+    event->setDtStart(start);
+    Recurrence *recurrence = event->recurrence();
+    recurrence->setWeekly(1);
+    QBitArray days(7);
+    days.setBit(0);  // Monday
+    days.setBit(3);  // Thursday
+    recurrence->addWeeklyDays(days);
+
+    const QDateTime from = start.addDays(200);
+    const QDateTime to = start.addDays(230);
+    const auto first = recurrence->timesInInterval(from, to);
+    QCOMPARE(first.count(), 8);
+    QCOMPARE(recurrence->timesInInterval(from, to), first);
+
+    // Walk over more weeks than are kept expanded, then come back
+    const auto all = recurrence->timesInInterval(start, start.addDays(7 * 200 - 1));
+    QCOMPARE(all.count(), 400);
+    QCOMPARE(recurrence->timesInInterval(from, to), first);
+    QVERIFY(recurrence->recursOn(first.first().date(), Qt::UTC));
+    QCOMPARE(recurrence->getNextDateTime(from), first.first());
+
+    // Changing the rule must not return dates of the old rule
+    recurrence->defaultRRule()->setByDays(QList<RecurrenceRule::WDayPos>() << RecurrenceRule::WDayPos(0, 1));
+    const auto changed = recurrence->timesInInterval(from, to);
+    QCOMPARE(changed.count(), 4);
+    for (const QDateTime &dt : changed) {
+        QCOMPARE(dt.date().dayOfWeek(), 1);
+    }
+    QVERIFY(!recurrence->recursOn(QDate(2013, 1, 10), Qt::UTC));
+}
+
+void TimesInIntervalTest::testSimpleRules_data()
+{
+    QTest::addColumn<QDateTime>("start");
+    QTest::addColumn<QString>("rrule");
+
+    const QDateTime wednesday(QDate(2013, 1, 9), QTime(9, 30, 0), Qt::UTC);
+    const QTimeZone berlin("Europe/Berlin");
+    QTest::newRow("daily") << wednesday << QStringLiteral("FREQ=DAILY;INTERVAL=3");
+    QTest::newRow("daily until") << wednesday << QStringLiteral("FREQ=DAILY;UNTIL=20130419T093000Z");
+    QTest::newRow("daily count") << wednesday << QStringLiteral("FREQ=DAILY;COUNT=20");
+    QTest::newRow("weekly") << wednesday << QStringLiteral("FREQ=WEEKLY");
+    QTest::newRow("weekly byday") << wednesday << QStringLiteral("FREQ=WEEKLY;INTERVAL=2;BYDAY=MO,WE,SU");
+    QTest::newRow("weekly wkst") << wednesday << QStringLiteral("FREQ=WEEKLY;INTERVAL=2;BYDAY=MO,TH;WKST=SU");
+    QTest::newRow("monthly") << QDateTime(QDate(2013, 1, 31), QTime(9, 30, 0), Qt::UTC)
+                             << QStringLiteral("FREQ=MONTHLY");
+    QTest::newRow("monthly bymonthday") << wednesday << QStringLiteral("FREQ=MONTHLY;INTERVAL=2;BYMONTHDAY=1,9,30");
+    QTest::newRow("daily dst") << QDateTime(QDate(2013, 1, 9), QTime(2, 30, 0), berlin)
+                               << QStringLiteral("FREQ=DAILY");
+    QTest::newRow("monthly month end") << QDateTime(QDate(2015, 12, 31), QTime(9, 30, 0), Qt::UTC)
+                                       << QStringLiteral("FREQ=MONTHLY;BYMONTHDAY=28,29,30,31");
+    QTest::newRow("monthly dst") << QDateTime(QDate(2013, 1, 31), QTime(2, 30, 0), berlin)
+                                 << QStringLiteral("FREQ=MONTHLY;BYMONTHDAY=27,31");
+    QTest::newRow("weekly dst") << QDateTime(QDate(2013, 1, 6), QTime(1, 30, 0), QTimeZone("America/New_York"))
+                                << QStringLiteral("FREQ=WEEKLY;BYDAY=SU");
+}
+
+//Test that the different ways to query simple rules agree with each other
+void TimesInIntervalTest::testSimpleRules()
+{
+    QFETCH(QDateTime, start);
+    QFETCH(QString, rrule);
+
+    RecurrenceRule rule;
+    ICalFormat format;
+    QVERIFY(format.fromString(&rule, rrule));
+    rule.setStartDt(start);
+
+    const QDateTime end = start.addDays(400);
+    const auto times = rule.timesInInterval(start, end);
+    QVERIFY(!times.isEmpty());
+
+    QDateTime dt = start.addSecs(-1);
+    for (int i = 0; i < times.count(); ++i) {
+        dt = rule.getNextDate(dt);
+        QCOMPARE(dt, times[i]);
+        QVERIFY(rule.recursAt(dt));
+        QVERIFY(rule.recursOn(dt.date(), dt.timeZone()));
+        QCOMPARE(rule.durationTo(dt), i + 1);
+        QCOMPARE(rule.durationTo(dt.addSecs(-1)), i);
+        if (i > 0) {
+            QCOMPARE(rule.getPreviousDate(dt), times[i - 1]);
+        }
+    }
+    if (rule.duration() < 0) {
+        QCOMPARE(rule.getNextDate(times.last()), rule.timesInInterval(end.addSecs(1), end.addDays(40)).first());
+    } else {
+        QVERIFY(!rule.getNextDate(times.last()).isValid());
+    }
+    QVERIFY(!rule.getPreviousDate(times.first()).isValid());
+
+    // There is one occurrence on each recurring day
+    int days = 0;
+    for (QDate date = start.date(); date <= times.last().date(); date = date.addDays(1)) {
+        if (rule.recursOn(date, start.timeZone())) {
+            ++days;
+        }
+    }
+    QCOMPARE(days, times.count());
+
+    // A constraint on every month does not change the occurrences, but has
+    // the rule expanded through the constraints instead of day arithmetic
+    RecurrenceRule generic;
+    QVERIFY(format.fromString(&generic, rrule + QStringLiteral(";BYMONTH=1,2,3,4,5,6,7,8,9,10,11,12")));
+    generic.setStartDt(start);
+    QCOMPARE(generic.timesInInterval(start, end), times);
+    for (QDate date = start.date().addDays(-1); date <= end.date(); date = date.addDays(1)) {
+        QCOMPARE(rule.recursOn(date, start.timeZone()), generic.recursOn(date, start.timeZone()));
+        const QDateTime noon(date, QTime(12, 0, 0), start.timeZone());
+        QCOMPARE(rule.getNextDate(noon), generic.getNextDate(noon));
+        QCOMPARE(rule.getPreviousDate(noon), generic.getPreviousDate(noon));
+        QCOMPARE(rule.durationTo(noon), generic.durationTo(noon));
+    }
+}
+
+//Test that recurrenceDays() agrees with recursOn()
+void TimesInIntervalTest::testRecurrenceDays()
+{
+    const QDateTime start(QDate(2013, 1, 9), QTime(2, 0, 0), Qt::UTC);
+    const QDate from(2012, 12, 20);
+    const QDate to(2013, 4, 10);
+    const QTimeZone newYork("America/New_York");
+
+    Event::Ptr weekly(new Event());
+    weekly->setDtStart(start);
+    weekly->setDtEnd(start.addSecs(3600));
+    weekly->recurrence()->setWeekly(1);
+    weekly->recurrence()->addExDate(QDate(2013, 1, 23));
+    weekly->recurrence()->addRDate(QDate(2013, 2, 2));
+    weekly->recurrence()->addRDateTime(QDateTime(QDate(2013, 3, 3), QTime(23, 0, 0), Qt::UTC));
+
+    Event::Ptr allDay(new Event());
+    allDay->setDtStart(start);
+    allDay->setAllDay(true);
+    allDay->recurrence()->setMonthly(1);
+    allDay->recurrence()->setDuration(3);
+
+    Event::Ptr excluded(new Event());
+    excluded->setDtStart(start);
+    excluded->recurrence()->setDaily(2);
+    excluded->recurrence()->addExDateTime(start.addDays(4));
+
+    const QList<Event::Ptr> events = {weekly, allDay, excluded};
+    for (const Event::Ptr &event : events) {
+        for (const QTimeZone &tz : {QTimeZone::utc(), newYork}) {
+            const QBitArray days = event->recurrence()->recurrenceDays(from, to, tz);
+            QCOMPARE(days.size(), int(from.daysTo(to)) + 1);
+            for (int i = 0; i < days.size(); ++i) {
+                QCOMPARE(days.testBit(i), event->recursOn(from.addDays(i), tz));
+            }
+        }
+    }
+    QVERIFY(weekly->recurrence()->recurrenceDays(to, from, newYork).isEmpty());
+}
@@ -33,6 +33,10 @@ private Q_SLOTS:
     void testSubDailyRecurrenceIntervalInclusive();
     void testSubDailyRecurrence2();
     void testSubDailyRecurrenceIntervalLimits();
+    void testRepeatedQueries();
+    void testSimpleRules_data();
+    void testSimpleRules();
+    void testRecurrenceDays();
 };
 
 #endif
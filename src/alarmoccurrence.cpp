@@ -0,0 +1,111 @@
+/*
+  This file is part of the kcalcore library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with this library; see the file COPYING.LIB.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+/**
+  @file
+  This file is part of the API for handling calendar data and
+  defines the AlarmOccurrence class.
+*/
+
+#include "alarmoccurrence.h"
+
+using namespace KCalendarCore;
+
+//@cond PRIVATE
+class Q_DECL_HIDDEN KCalendarCore::AlarmOccurrence::Private
+{
+public:
+    Private() = default;
+    Private(const Alarm::Ptr &alarm, const Incidence::Ptr &incidence,
+            const QDateTime &recurrenceId, const QDateTime &triggerTime)
+        : mAlarm(alarm),
+          mIncidence(incidence),
+          mRecurrenceId(recurrenceId),
+          mTriggerTime(triggerTime)
+    {}
+    Alarm::Ptr mAlarm;
+    Incidence::Ptr mIncidence;
+    QDateTime mRecurrenceId;
+    QDateTime mTriggerTime;
+};
+//@endcond
+
+AlarmOccurrence::AlarmOccurrence()
+    : d(new KCalendarCore::AlarmOccurrence::Private())
+{
+}
+
+AlarmOccurrence::AlarmOccurrence(const Alarm::Ptr &alarm, const Incidence::Ptr &incidence,
+                                 const QDateTime &recurrenceId, const QDateTime &triggerTime)
+    : d(new KCalendarCore::AlarmOccurrence::Private(alarm, incidence, recurrenceId, triggerTime))
+{
+}
+
+AlarmOccurrence::AlarmOccurrence(const AlarmOccurrence &other)
+    : d(new KCalendarCore::AlarmOccurrence::Private(*other.d))
+{
+}
+
+AlarmOccurrence::~AlarmOccurrence()
+{
+    delete d;
+}
+
+AlarmOccurrence &AlarmOccurrence::operator=(const AlarmOccurrence &other)
+{
+    // check for self assignment
+    if (&other == this) {
+        return *this;
+    }
+
+    *d = *other.d;
+    return *this;
+}
+
+bool AlarmOccurrence::operator==(const AlarmOccurrence &other) const
+{
+    return d->mAlarm == other.d->mAlarm &&
+           d->mIncidence == other.d->mIncidence &&
+           d->mRecurrenceId == other.d->mRecurrenceId &&
+           d->mTriggerTime == other.d->mTriggerTime;
+}
+
+bool AlarmOccurrence::isValid() const
+{
+    return d->mAlarm && d->mTriggerTime.isValid();
+}
+
+Alarm::Ptr AlarmOccurrence::alarm() const
+{
+    return d->mAlarm;
+}
+
+Incidence::Ptr AlarmOccurrence::incidence() const
+{
+    return d->mIncidence;
+}
+
+QDateTime AlarmOccurrence::recurrenceId() const
+{
+    return d->mRecurrenceId;
+}
+
+QDateTime AlarmOccurrence::triggerTime() const
+{
+    return d->mTriggerTime;
+}
@@ -0,0 +1,156 @@
+/*
+  This file is part of the kcalcore library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with this library; see the file COPYING.LIB.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+/**
+  @file
+  This file is part of the API for handling calendar data and
+  defines the AlarmOccurrence class.
+
+  @brief
+  Represents one trigger of an alarm.
+*/
+#ifndef KCALCORE_ALARMOCCURRENCE_H
+#define KCALCORE_ALARMOCCURRENCE_H
+
+#include "kcalendarcore_export.h"
+#include "alarm.h"
+#include "incidence.h"
+
+#include <QDateTime>
+#include <QMetaType>
+#include <QVector>
+
+namespace KCalendarCore
+{
+
+/**
+  @brief
+  An alarm triggering at a given time.
+
+  Holds the alarm, the incidence it belongs to, the occurrence of the
+  incidence it is for and the time it triggers, as found by
+  Calendar::alarmOccurrences().
+
+  @since 5.64
+*/
+class KCALENDARCORE_EXPORT AlarmOccurrence
+{
+public:
+    /**
+       List of alarm occurrences.
+     */
+    typedef QVector<AlarmOccurrence> List;
+
+    /**
+      Constructs an invalid alarm occurrence.
+    */
+    AlarmOccurrence();
+
+    /**
+      Constructs an alarm occurrence.
+
+      @param alarm is the alarm which triggers.
+      @param incidence is the incidence the alarm belongs to.
+      @param recurrenceId is the start of the occurrence of @p incidence
+      the alarm triggers for, or an invalid QDateTime if the alarm is not
+      for a particular occurrence.
+      @param triggerTime is the time the alarm triggers.
+    */
+    AlarmOccurrence(const Alarm::Ptr &alarm, const Incidence::Ptr &incidence,
+                    const QDateTime &recurrenceId, const QDateTime &triggerTime);
+
+    /**
+      Constructs an alarm occurrence from another one.
+
+      @param other is the alarm occurrence to copy.
+    */
+    AlarmOccurrence(const AlarmOccurrence &other);
+
+    /**
+      Destroys the alarm occurrence.
+    */
+    ~AlarmOccurrence();
+
+    /**
+      Sets this alarm occurrence equal to @p other.
+
+      @param other is the alarm occurrence to copy.
+    */
+    AlarmOccurrence &operator=(const AlarmOccurrence &other);
+
+    /**
+      Returns true if this alarm occurrence is equal to @p other.
+
+      @param other is the alarm occurrence to compare.
+    */
+    bool operator==(const AlarmOccurrence &other) const;
+
+    /**
+      Returns true if this alarm occurrence is not equal to @p other.
+
+      @param other is the alarm occurrence to compare.
+      @see operator==()
+    */
+    bool operator!=(const AlarmOccurrence &other) const
+    {
+        return !operator==(other);
+    }
+
+    /**
+      Returns true if the alarm occurrence has an alarm and a trigger time.
+    */
+    Q_REQUIRED_RESULT bool isValid() const;
+
+    /**
+      Returns the alarm which triggers.
+    */
+    Q_REQUIRED_RESULT Alarm::Ptr alarm() const;
+
+    /**
+      Returns the incidence the alarm belongs to.
+    */
+    Q_REQUIRED_RESULT Incidence::Ptr incidence() const;
+
+    /**
+      Returns the start of the occurrence of the incidence the alarm
+      triggers for, or an invalid QDateTime if the alarm is not for a
+      particular occurrence, for instance because the incidence does not
+      recur or the alarm has an absolute time.
+    */
+    Q_REQUIRED_RESULT QDateTime recurrenceId() const;
+
+    /**
+      Returns the time the alarm triggers.
+    */
+    Q_REQUIRED_RESULT QDateTime triggerTime() const;
+
+private:
+    //@cond PRIVATE
+    class Private;
+    Private *const d;
+    //@endcond
+};
+
+} // namespace KCalendarCore
+
+//@cond PRIVATE
+Q_DECLARE_METATYPE(KCalendarCore::AlarmOccurrence)
+Q_DECLARE_TYPEINFO(KCalendarCore::AlarmOccurrence, Q_MOVABLE_TYPE);
+//@endcond
+
+#endif
@@ -43,6 +43,7 @@
 
 #include "kcalendarcore_debug.h"
 
+#include <QSet>
 #include <QTimeZone>
 
 extern "C" {
@@ -50,6 +51,7 @@ extern "C" {
 }
 
 #include <algorithm>  // for std::remove()
+#include <limits>
 
 using namespace KCalendarCore;
 
@@ -208,6 +210,8 @@ void Calendar::shiftTimes(const QTimeZone &oldZone, const QTimeZone &newZone)
 {
     setTimeZone(newZone);
 
+    startBatchChanges();
+
     int i, end;
     Event::List ev = events();
     for (i = 0, end = ev.count();  i < end;  ++i) {
@@ -223,6 +227,8 @@ void Calendar::shiftTimes(const QTimeZone &oldZone, const QTimeZone &newZone)
     for (i = 0, end = jo.count();  i < end;  ++i) {
         jo[i]->shiftTimes(oldZone, newZone);
     }
+
+    endBatchChanges();
 }
 
 void Calendar::setFilter(CalFilter *filter)
@@ -242,20 +248,19 @@ CalFilter *Calendar::filter() const
 
 QStringList Calendar::categories() const
 {
-    Incidence::List rawInc(rawIncidences());
-    QStringList cats, thisCats;
+    QStringList cats;
+    QSet<QString> seen;
     // @TODO: For now just iterate over all incidences. In the future,
     // the list of categories should be built when reading the file.
-    for (Incidence::List::ConstIterator i = rawInc.constBegin();
-            i != rawInc.constEnd(); ++i) {
-        thisCats = (*i)->categories();
-        for (QStringList::ConstIterator si = thisCats.constBegin();
-                si != thisCats.constEnd(); ++si) {
-            if (!cats.contains(*si)) {
-                cats.append(*si);
+    forEachIncidence([&](const Incidence::Ptr &incidence) {
+        const QStringList thisCats = incidence->categories();
+        for (const QString &cat : thisCats) {
+            if (!seen.contains(cat)) {
+                seen.insert(cat);
+                cats.append(cat);
             }
         }
-    }
+    });
     return cats;
 }
 
@@ -274,6 +279,40 @@ Incidence::List Calendar::rawIncidences() const
     return mergeIncidenceList(rawEvents(), rawTodos(), rawJournals());
 }
 
+void Calendar::forEachIncidence(const std::function<void(const Incidence::Ptr &)> &func) const
+{
+    forEachIncidence(Incidence::TypeUnknown, func);
+}
+
+void Calendar::forEachIncidence(IncidenceBase::IncidenceType type,
+                                const std::function<void(const Incidence::Ptr &)> &func) const
+{
+    if (d->mForEachIncidence) {
+        d->mForEachIncidence(type, func);
+        return;
+    }
+
+    // No direct access to the storage, so go through the lists
+    if (type == Incidence::TypeEvent || type == Incidence::TypeUnknown) {
+        const Event::List events = rawEvents();
+        for (const Event::Ptr &event : events) {
+            func(event);
+        }
+    }
+    if (type == Incidence::TypeTodo || type == Incidence::TypeUnknown) {
+        const Todo::List todos = rawTodos();
+        for (const Todo::Ptr &todo : todos) {
+            func(todo);
+        }
+    }
+    if (type == Incidence::TypeJournal || type == Incidence::TypeUnknown) {
+        const Journal::List journals = rawJournals();
+        for (const Journal::Ptr &journal : journals) {
+            func(journal);
+        }
+    }
+}
+
 Incidence::List Calendar::instances(const Incidence::Ptr &incidence) const
 {
     if (incidence) {
@@ -294,25 +333,57 @@ Incidence::List Calendar::instances(const Incidence::Ptr &incidence) const
     }
 }
 
+//@cond PRIVATE
+QPair<qint64, QString> Calendar::Private::contentKey(const Incidence::Ptr &incidence)
+{
+    // All incidences without a valid start share one key
+    const QDateTime start = incidence->dtStart();
+    return qMakePair(start.isValid() ? start.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min(),
+                     incidence->summary());
+}
+
+void Calendar::Private::indexContent(const Incidence::Ptr &incidence)
+{
+    if (!mContentKeys.contains(incidence)) {
+        const auto key = contentKey(incidence);
+        mContentKeys.insert(incidence, key);
+        mIncidencesByContent.insert(key, incidence);
+    }
+}
+
+void Calendar::Private::unindexContent(const Incidence::Ptr &incidence)
+{
+    const auto it = mContentKeys.find(incidence);
+    if (it != mContentKeys.end()) {
+        mIncidencesByContent.remove(it.value(), incidence);
+        mContentKeys.erase(it);
+    }
+}
+//@endcond
+
 Incidence::List Calendar::duplicates(const Incidence::Ptr &incidence)
 {
     if (incidence) {
-        Incidence::List list;
-        Incidence::List vals = values(d->mNotebookIncidences);
-        Incidence::List::const_iterator it;
-        for (it = vals.constBegin(); it != vals.constEnd(); ++it) {
-            if (((incidence->dtStart() == (*it)->dtStart()) ||
-                    (!incidence->dtStart().isValid() && !(*it)->dtStart().isValid())) &&
-                    (incidence->summary() == (*it)->summary())) {
-                list.append(*it);
-            }
-        }
-        return list;
+        return values(d->mIncidencesByContent, Private::contentKey(incidence));
     } else {
         return Incidence::List();
     }
 }
 
+QVector<Incidence::List> Calendar::duplicates(const Incidence::List &incidences)
+{
+    QVector<Incidence::List> result;
+    result.reserve(incidences.count());
+    for (const Incidence::Ptr &incidence : incidences) {
+        if (incidence) {
+            result.append(values(d->mIncidencesByContent, Private::contentKey(incidence)));
+        } else {
+            result.append(Incidence::List());
+        }
+    }
+    return result;
+}
+
 bool Calendar::addNotebook(const QString &notebook, bool isVisible)
 {
     if (d->mNotebooks.contains(notebook)) {
@@ -382,6 +453,8 @@ bool Calendar::isVisible(const Incidence::Ptr &incidence) const
 void Calendar::clearNotebookAssociations()
 {
     d->mNotebookIncidences.clear();
+    d->mIncidencesByContent.clear();
+    d->mContentKeys.clear();
     d->mUidToNotebook.clear();
     d->mIncidenceVisibility.clear();
 }
@@ -415,11 +488,13 @@ bool Calendar::setNotebook(const Incidence::Ptr &inc, const QString &notebook)
             notifyIncidenceChanged(inc);   // for removing from old notebook
             // don not remove from mUidToNotebook to keep deleted incidences
             d->mNotebookIncidences.remove(old, inc);
+            d->unindexContent(inc);
         }
     }
     if (!notebook.isEmpty()) {
         d->mUidToNotebook.insert(inc->uid(), notebook);
         d->mNotebookIncidences.insert(notebook, inc);
+        d->indexContent(inc);
         qCDebug(KCALCORE_LOG) << "setting notebook" << notebook << "for" << inc->uid();
         notifyIncidenceChanged(inc);   // for inserting into new notebook
     }
@@ -546,6 +621,45 @@ bool Calendar::addIncidence(const Incidence::Ptr &incidence)
     return incidence->accept(v, incidence);
 }
 
+bool Calendar::addIncidences(const Incidence::List &incidences)
+{
+    if (d->mInsertIncidences) {
+        return d->mInsertIncidences(incidences);
+    }
+
+    bool success = true;
+    for (const Incidence::Ptr &incidence : incidences) {
+        success = addIncidence(incidence) && success;
+    }
+    return success;
+}
+
+void Calendar::startBatchChanges()
+{
+    ++d->mBatchChangeDepth;
+}
+
+void Calendar::endBatchChanges()
+{
+    if (d->mBatchChangeDepth == 0 || --d->mBatchChangeDepth > 0) {
+        return;
+    }
+
+    Incidence::List incidences;
+    incidences.reserve(d->mPendingChanges.count());
+    for (const auto &change : qAsConst(d->mPendingChanges)) {
+        if (change.incidence) {
+            // Observers may reset the dirty fields of one change before the next
+            change.incidence->setDirtyFields(change.dirtyFields + change.incidence->dirtyFields());
+            incidences.append(change.incidence);
+        }
+    }
+    d->mPendingChanges.clear();
+    d->mPendingChangeIndex.clear();
+
+    notifyIncidencesChanged(incidences);
+}
+
 bool Calendar::deleteIncidence(const Incidence::Ptr &incidence)
 {
     if (!incidence) {
@@ -633,28 +747,24 @@ Incidence::Ptr Calendar::deleted(const QString &uid, const QDateTime &recurrence
 Incidence::List Calendar::incidencesFromSchedulingID(const QString &sid) const
 {
     Incidence::List result;
-    const Incidence::List incidences = rawIncidences();
-    Incidence::List::const_iterator it = incidences.begin();
-    for (; it != incidences.end(); ++it) {
-        if ((*it)->schedulingID() == sid) {
-            result.append(*it);
+    forEachIncidence([&](const Incidence::Ptr &incidence) {
+        if (incidence->schedulingID() == sid) {
+            result.append(incidence);
         }
-    }
+    });
     return result;
 }
 
 Incidence::Ptr Calendar::incidenceFromSchedulingID(const QString &uid) const
 {
-    const Incidence::List incidences = rawIncidences();
-    Incidence::List::const_iterator it = incidences.begin();
-    for (; it != incidences.end(); ++it) {
-        if ((*it)->schedulingID() == uid) {
+    Incidence::Ptr result;
+    forEachIncidence([&](const Incidence::Ptr &incidence) {
+        if (!result && incidence->schedulingID() == uid) {
             // Touchdown, and the crowd goes wild
-            return *it;
+            result = incidence;
         }
-    }
-    // Not found
-    return Incidence::Ptr();
+    });
+    return result;
 }
 
 /** static */
@@ -803,6 +913,26 @@ Journal::List Calendar::journals(const QDate &date) const
     return el;
 }
 
+void Calendar::Private::queueChange(const Incidence::Ptr &incidence)
+{
+    const auto it = mPendingChangeIndex.constFind(incidence);
+    if (it == mPendingChangeIndex.constEnd()) {
+        mPendingChangeIndex.insert(incidence, mPendingChanges.count());
+        mPendingChanges.append(PendingChange{incidence, incidence->dirtyFields()});
+    } else {
+        mPendingChanges[it.value()].dirtyFields += incidence->dirtyFields();
+    }
+}
+
+void Calendar::Private::dropChange(const Incidence::Ptr &incidence)
+{
+    const auto it = mPendingChangeIndex.find(incidence);
+    if (it != mPendingChangeIndex.end()) {
+        mPendingChanges[it.value()].incidence.clear();
+        mPendingChangeIndex.erase(it);
+    }
+}
+
 // When this is called, the to-dos have already been added to the calendar.
 // This method is only about linking related to-dos.
 void Calendar::setupRelations(const Incidence::Ptr &forincidence)
@@ -811,49 +941,36 @@ void Calendar::setupRelations(const Incidence::Ptr &forincidence)
         return;
     }
 
-    const QString uid = forincidence->uid();
-
-    // First, go over the list of orphans and see if this is their parent
-    Incidence::List l = values(d->mOrphans, uid);
-    d->mOrphans.remove(uid);
-    if (!l.isEmpty()) {
-        Incidence::List &relations = d->mIncidenceRelations[uid];
-        relations.reserve(relations.count() + l.count());
-        for (int i = 0, end = l.count();  i < end;  ++i) {
-            relations.append(l[i]);
-            d->mOrphanUids.remove(l[i]->uid());
-        }
-    }
-
-    // Now see about this incidences parent
-    if (forincidence->relatedTo().isEmpty() && !forincidence->relatedTo().isEmpty()) {
-        // Incidence has a uid it is related to but is not registered to it yet.
-        // Try to find it
-        Incidence::Ptr parent = incidence(forincidence->relatedTo());
-        if (parent) {
-            // Found it
-
+    // Children added before this incidence are already filed under its uid,
+    // so only its own parent needs to be looked at
+    const QString parentUid = forincidence->relatedTo();
+    if (d->mRelationFilings.value(forincidence).parentUid != parentUid) {
+        // New, or the incidence was moved to another parent
+        d->unfileRelation(forincidence);
+        if (!parentUid.isEmpty()) {
             // look for hierarchy loops
-            if (isAncestorOf(forincidence, parent)) {
+            Incidence::Ptr parent = incidence(parentUid);
+            if (parent && isAncestorOf(forincidence, parent)) {
                 forincidence->setRelatedTo(QString());
                 qCWarning(KCALCORE_LOG) << "hierarchy loop between "
                                         << forincidence->uid()
                                         << " and " << parent->uid();
             } else {
-                d->mIncidenceRelations[parent->uid()].append(forincidence);
+                // If the parent is not found, the incidence waits here for
+                // it to be inserted
+                d->fileRelation(forincidence, parentUid);
             }
-        } else {
-            // Not found, put this in the mOrphans list
-            // Note that the mOrphans dict might contain multiple entries with the
-            // same key! which are multiple children that wait for the parent
-            // incidence to be inserted.
-            d->mOrphans.insert(forincidence->relatedTo(), forincidence);
-            d->mOrphanUids.insert(forincidence->uid(), forincidence);
         }
     }
+
+    // Exceptions share the place of their series in the hierarchy
+    if (!forincidence->hasRecurrenceId()) {
+        d->mParentUids.insert(forincidence->uid(), forincidence->relatedTo());
+    }
 }
 
-// If a to-do with sub-to-dos is deleted, move it's sub-to-dos to the orphan list
+// If a to-do with sub-to-dos is deleted, its sub-to-dos stay filed under its
+// uid and wait for an incidence with that uid to be inserted again
 void Calendar::removeRelations(const Incidence::Ptr &incidence)
 {
     if (!incidence) {
@@ -861,67 +978,11 @@ void Calendar::removeRelations(const Incidence::Ptr &incidence)
         return;
     }
 
-    const QString uid = incidence->uid();
-
-    for (const Incidence::Ptr &i : qAsConst(d->mIncidenceRelations[uid])) {
-        if (!d->mOrphanUids.contains(i->uid())) {
-            d->mOrphans.insert(uid, i);
-            d->mOrphanUids.insert(i->uid(), i);
-            i->setRelatedTo(uid);
-        }
-    }
-
-    const QString parentUid = incidence->relatedTo();
-
     // If this incidence is related to something else, tell that about it
-    if (!parentUid.isEmpty()) {
-        Incidence::List &relations = d->mIncidenceRelations[parentUid];
-        relations.erase(
-            std::remove(relations.begin(), relations.end(), incidence),
-            relations.end());
-    }
-
-    // Remove this one from the orphans list
-    if (d->mOrphanUids.remove(uid)) {
-        // This incidence is located in the orphans list - it should be removed
-        // Since the mOrphans dict might contain the same key (with different
-        // child incidence pointers!) multiple times, take care that we remove
-        // the correct one. So we need to remove all items with the given
-        // parent UID, and readd those that are not for this item. Also, there
-        // might be other entries with differnet UID that point to this
-        // incidence (this might happen when the relatedTo of the item is
-        // changed before its parent is inserted. This might happen with
-        // groupware servers....). Remove them, too
-        QStringList relatedToUids;
-
-        // First, create a list of all keys in the mOrphans list which point
-        // to the removed item
-        relatedToUids << incidence->relatedTo();
-        for (QMultiHash<QString, Incidence::Ptr>::Iterator it = d->mOrphans.begin();
-                it != d->mOrphans.end(); ++it) {
-            if (it.value()->uid() == uid) {
-                relatedToUids << it.key();
-            }
-        }
+    d->unfileRelation(incidence);
 
-        // now go through all uids that have one entry that point to the incidence
-        for (QStringList::const_iterator uidit = relatedToUids.constBegin();
-                uidit != relatedToUids.constEnd(); ++uidit) {
-            Incidence::List tempList;
-            // Remove all to get access to the remaining entries
-            const Incidence::List l = values(d->mOrphans, *uidit);
-            d->mOrphans.remove(*uidit);
-            for (const Incidence::Ptr &i : l) {
-                if (i != incidence) {
-                    tempList.append(i);
-                }
-            }
-            // Readd those that point to a different orphan incidence
-            for (Incidence::List::Iterator incit = tempList.begin();
-                    incit != tempList.end(); ++incit) {
-                d->mOrphans.insert(*uidit, *incit);
-            }
-        }
+    if (!incidence->hasRecurrenceId()) {
+        d->mParentUids.remove(incidence->uid());
     }
 
     // Make sure the deleted incidence doesn't relate to a non-deleted incidence,
@@ -937,21 +998,95 @@ void Calendar::removeRelations(const Incidence::Ptr &incidence)
 //  incidence->setRelatedTo( Incidence::Ptr() );
 }
 
+void Calendar::Private::fileRelation(const Incidence::Ptr &incidence, const QString &parentUid)
+{
+    Incidence::List &relations = mIncidenceRelations[parentUid];
+    mRelationFilings.insert(incidence, RelationFiling{parentUid, relations.count()});
+    relations.append(incidence);
+}
+
+void Calendar::Private::unfileRelation(const Incidence::Ptr &incidence)
+{
+    const auto filing = mRelationFilings.find(incidence);
+    if (filing == mRelationFilings.end()) {
+        return;
+    }
+    const auto it = mIncidenceRelations.find(filing->parentUid);
+    const int index = filing->index;
+    mRelationFilings.erase(filing);
+    if (it == mIncidenceRelations.end()) {
+        return;
+    }
+
+    // Move the last sibling into the gap, so removal takes constant time
+    Incidence::List &relations = it.value();
+    const Incidence::Ptr last = relations.takeLast();
+    if (index < relations.count()) {
+        relations[index] = last;
+        mRelationFilings[last].index = index;
+    }
+    if (relations.isEmpty()) {
+        mIncidenceRelations.erase(it);
+    }
+}
+
 bool Calendar::isAncestorOf(const Incidence::Ptr &ancestor,
                             const Incidence::Ptr &incidence) const
 {
-    if (!incidence || incidence->relatedTo().isEmpty()) {
+    if (!ancestor || !incidence) {
         return false;
-    } else if (incidence->relatedTo() == ancestor->uid()) {
-        return true;
-    } else {
-        return isAncestorOf(ancestor, this->incidence(incidence->relatedTo()));
     }
+
+    const QString ancestorUid = ancestor->uid();
+    QString uid = incidence->relatedTo();
+    // Related-to UIDs of incidences waiting for their parent may form a
+    // loop, so never take more steps than there are incidences
+    for (int steps = 0, end = d->mParentUids.count();  !uid.isEmpty() && steps <= end;  ++steps) {
+        if (uid == ancestorUid) {
+            return true;
+        }
+        uid = d->mParentUids.value(uid);
+    }
+    return false;
+}
+
+QStringList Calendar::ancestorUids(const QString &uid) const
+{
+    QStringList uids;
+    auto it = d->mParentUids.constFind(uid);
+    while (it != d->mParentUids.constEnd() && !it->isEmpty() &&
+            uids.count() < d->mParentUids.count()) {
+        const QString parentUid = it.value();
+        it = d->mParentUids.constFind(parentUid);
+        if (it == d->mParentUids.constEnd()) {
+            // The parent is not in the calendar
+            break;
+        }
+        uids.append(parentUid);
+    }
+    return uids;
 }
 
 Incidence::List Calendar::relations(const QString &uid) const
 {
-    return d->mIncidenceRelations[uid];
+    return d->mIncidenceRelations.value(uid);
+}
+
+Incidence::List Calendar::descendants(const QString &uid) const
+{
+    Incidence::List result;
+    QSet<QString> visited;
+    visited.insert(uid);
+    result += d->mIncidenceRelations.value(uid);
+    // result doubles as the queue of the breadth-first walk
+    for (int i = 0;  i < result.count();  ++i) {
+        const QString childUid = result.at(i)->uid();
+        if (!visited.contains(childUid)) {
+            visited.insert(childUid);
+            result += d->mIncidenceRelations.value(childUid);
+        }
+    }
+    return result;
 }
 
 Calendar::CalendarObserver::~CalendarObserver()
@@ -990,6 +1125,10 @@ void Calendar::CalendarObserver::calendarIncidenceAdditionCanceled(const Inciden
     Q_UNUSED(incidence);
 }
 
+Calendar::BatchObserver::~BatchObserver()
+{
+}
+
 void Calendar::registerObserver(CalendarObserver *observer)
 {
     if (!observer) {
@@ -1080,11 +1219,41 @@ void Calendar::notifyIncidenceAdded(const Incidence::Ptr &incidence)
         observer->calendarIncidenceAdded(incidence);
     }
 
+    d->addTimeZones(incidence);
+}
+
+void Calendar::notifyIncidencesAdded(const Incidence::List &incidences)
+{
+    if (incidences.isEmpty()) {
+        return;
+    }
+
+    if (!d->mObserversEnabled) {
+        return;
+    }
+
+    for (CalendarObserver *observer : qAsConst(d->mObservers)) {
+        if (auto batchObserver = dynamic_cast<BatchObserver *>(observer)) {
+            batchObserver->calendarIncidencesAdded(incidences);
+        } else {
+            for (const Incidence::Ptr &incidence : incidences) {
+                observer->calendarIncidenceAdded(incidence);
+            }
+        }
+    }
+
+    for (const Incidence::Ptr &incidence : incidences) {
+        d->addTimeZones(incidence);
+    }
+}
+
+void Calendar::Private::addTimeZones(const Incidence::Ptr &incidence)
+{
     for (auto role : { IncidenceBase::RoleStartTimeZone, IncidenceBase::RoleEndTimeZone }) {
         const auto dt = incidence->dateTime(role);
         if (dt.isValid() && dt.timeZone() != QTimeZone::utc()) {
-            if (!d->mTimeZones.contains(dt.timeZone())) {
-                d->mTimeZones.push_back(dt.timeZone());
+            if (!mTimeZones.contains(dt.timeZone())) {
+                mTimeZones.push_back(dt.timeZone());
             }
         }
     }
@@ -1096,21 +1265,59 @@ void Calendar::notifyIncidenceChanged(const Incidence::Ptr &incidence)
         return;
     }
 
+    // The start or summary may have changed
+    const auto key = d->mContentKeys.constFind(incidence);
+    if (key != d->mContentKeys.constEnd() && key.value() != Private::contentKey(incidence)) {
+        d->unindexContent(incidence);
+        d->indexContent(incidence);
+    }
+
     if (!d->mObserversEnabled) {
         return;
     }
 
+    if (d->mBatchChangeDepth > 0) {
+        d->queueChange(incidence);
+        return;
+    }
+
     for (CalendarObserver *observer : qAsConst(d->mObservers)) {
         observer->calendarIncidenceChanged(incidence);
     }
 }
 
+void Calendar::notifyIncidencesChanged(const Incidence::List &incidences)
+{
+    if (incidences.isEmpty()) {
+        return;
+    }
+
+    if (!d->mObserversEnabled) {
+        return;
+    }
+
+    for (CalendarObserver *observer : qAsConst(d->mObservers)) {
+        if (auto batchObserver = dynamic_cast<BatchObserver *>(observer)) {
+            batchObserver->calendarIncidencesChanged(incidences);
+        } else {
+            for (const Incidence::Ptr &incidence : incidences) {
+                observer->calendarIncidenceChanged(incidence);
+            }
+        }
+    }
+}
+
 void Calendar::notifyIncidenceAboutToBeDeleted(const Incidence::Ptr &incidence)
 {
     if (!incidence) {
         return;
     }
 
+    // Deleted incidences are not reported as changed
+    if (d->mBatchChangeDepth > 0) {
+        d->dropChange(incidence);
+    }
+
     if (!d->mObserversEnabled) {
         return;
     }
@@ -1228,110 +1435,152 @@ void Calendar::appendRecurringAlarms(Alarm::List &alarms,
                                      const QDateTime &from,
                                      const QDateTime &to) const
 {
-    QDateTime dt;
-    bool endOffsetValid = false;
-    Duration endOffset(0);
-    Duration period(from, to);
+    QDateTime trigger;
+    QDateTime occurrence;
 
     Alarm::List alarmlist = incidence->alarms();
     for (int i = 0, iend = alarmlist.count();  i < iend;  ++i) {
         Alarm::Ptr a = alarmlist[i];
-        if (a->enabled()) {
-            if (a->hasTime()) {
-                // The alarm time is defined as an absolute date/time
-                dt = a->nextRepetition(from.addSecs(-1));
-                if (!dt.isValid() || dt > to) {
-                    continue;
-                }
-            } else {
-                // Alarm time is defined by an offset from the event start or end time.
-                // Find the offset from the event start time, which is also used as the
-                // offset from the recurrence time.
-                Duration offset(0);
-                if (a->hasStartOffset()) {
-                    offset = a->startOffset();
-                } else if (a->hasEndOffset()) {
-                    offset = a->endOffset();
-                    if (!endOffsetValid) {
-                        endOffset = Duration(incidence->dtStart(),
-                                             incidence->dateTime(Incidence::RoleAlarmEndOffset));
-                        endOffsetValid = true;
-                    }
-                }
+        if (a->enabled() && Private::recurringAlarmTrigger(incidence, a, from, to, trigger, occurrence)) {
+            qCDebug(KCALCORE_LOG) << incidence->summary() << "':" << trigger.toString();
+            alarms.append(a);
+        }
+    }
+}
 
-                // Find the incidence's earliest alarm
-                QDateTime alarmStart =
-                    offset.end(a->hasEndOffset() ? incidence->dateTime(Incidence::RoleAlarmEndOffset) :
-                               incidence->dtStart());
-                if (alarmStart > to) {
-                    continue;
-                }
-                QDateTime baseStart = incidence->dtStart();
-                if (from > alarmStart) {
-                    alarmStart = from;   // don't look earlier than the earliest alarm
-                    baseStart = (-offset).end((-endOffset).end(alarmStart));
-                }
+// Finds the first trigger of alarm 'a' of a recurring incidence in the period
+// from 'from' to 'to', and the recurrence it is for
+bool Calendar::Private::recurringAlarmTrigger(const Incidence::Ptr &incidence,
+                                              const Alarm::Ptr &a,
+                                              const QDateTime &from,
+                                              const QDateTime &to,
+                                              QDateTime &trigger,
+                                              QDateTime &occurrence)
+{
+    occurrence = QDateTime();
+    if (a->hasTime()) {
+        // The alarm time is defined as an absolute date/time
+        trigger = a->nextRepetition(from.addSecs(-1));
+        return trigger.isValid() && trigger <= to;
+    }
 
-                // Adjust the 'alarmStart' date/time and find the next recurrence at or after it.
-                // Treate the two offsets separately in case one is daily and the other not.
-                dt = incidence->recurrence()->getNextDateTime(baseStart.addSecs(-1));
-                if (!dt.isValid() ||
-                        (dt = endOffset.end(offset.end(dt))) > to) {      // adjust 'dt' to get the alarm time
-                    // The next recurrence is too late.
-                    if (!a->repeatCount()) {
-                        continue;
-                    }
-
-                    // The alarm has repetitions, so check whether repetitions of previous
-                    // recurrences fall within the time period.
-                    bool found = false;
-                    Duration alarmDuration = a->duration();
-                    for (QDateTime base = baseStart;
-                            (dt = incidence->recurrence()->getPreviousDateTime(base)).isValid();
-                            base = dt) {
-                        if (a->duration().end(dt) < base) {
-                            break;  // this recurrence's last repetition is too early, so give up
-                        }
-
-                        // The last repetition of this recurrence is at or after 'alarmStart' time.
-                        // Check if a repetition occurs between 'alarmStart' and 'to'.
-                        int snooze = a->snoozeTime().value();   // in seconds or days
-                        if (a->snoozeTime().isDaily()) {
-                            Duration toFromDuration(dt, base);
-                            int toFrom = toFromDuration.asDays();
-                            if (a->snoozeTime().end(from) <= to ||
-                                    (toFromDuration.isDaily() && toFrom % snooze == 0) ||
-                                    (toFrom / snooze + 1) * snooze <= toFrom + period.asDays()) {
-                                found = true;
-#ifndef NDEBUG
-                                // for debug output
-                                dt = offset.end(dt).addDays(((toFrom - 1) / snooze + 1) * snooze);
-#endif
-                                break;
-                            }
-                        } else {
-                            int toFrom = dt.secsTo(base);
-                            if (period.asSeconds() >= snooze ||
-                                    toFrom % snooze == 0 ||
-                                    (toFrom / snooze + 1) * snooze <= toFrom + period.asSeconds()) {
-                                found = true;
-#ifndef NDEBUG
-                                // for debug output
-                                dt = offset.end(dt).addSecs(((toFrom - 1) / snooze + 1) * snooze);
-#endif
-                                break;
-                            }
-                        }
-                    }
-                    if (!found) {
-                        continue;
-                    }
-                }
+    // Alarm time is defined by an offset from the event start or end time.
+    // Find the offset from the event start time, which is also used as the
+    // offset from the recurrence time.
+    Duration offset(0);
+    Duration endOffset(0);
+    if (a->hasStartOffset()) {
+        offset = a->startOffset();
+    } else if (a->hasEndOffset()) {
+        offset = a->endOffset();
+        endOffset = Duration(incidence->dtStart(),
+                             incidence->dateTime(Incidence::RoleAlarmEndOffset));
+    }
+
+    // Find the incidence's earliest alarm
+    QDateTime alarmStart =
+        offset.end(a->hasEndOffset() ? incidence->dateTime(Incidence::RoleAlarmEndOffset) :
+                   incidence->dtStart());
+    if (alarmStart > to) {
+        return false;
+    }
+    QDateTime baseStart = incidence->dtStart();
+    if (from > alarmStart) {
+        alarmStart = from;   // don't look earlier than the earliest alarm
+        baseStart = (-offset).end((-endOffset).end(alarmStart));
+    }
+
+    // Adjust the 'alarmStart' date/time and find the next recurrence at or after it.
+    // Treate the two offsets separately in case one is daily and the other not.
+    QDateTime dt = incidence->recurrence()->getNextDateTime(baseStart.addSecs(-1));
+    if (dt.isValid() && (trigger = endOffset.end(offset.end(dt))) <= to) {      // adjust 'dt' to get the alarm time
+        occurrence = dt;
+        return true;
+    }
+
+    // The next recurrence is too late.
+    if (!a->repeatCount()) {
+        return false;
+    }
+
+    // The alarm has repetitions, so check whether repetitions of previous
+    // recurrences fall within the time period.
+    const Duration period(from, to);
+    const Duration snoozeTime = a->snoozeTime();
+    const int snooze = snoozeTime.value();   // in seconds or days
+    for (QDateTime base = baseStart;
+            (dt = incidence->recurrence()->getPreviousDateTime(base)).isValid();
+            base = dt) {
+        if (a->duration().end(dt) < base) {
+            break;  // this recurrence's last repetition is too early, so give up
+        }
+
+        // The last repetition of this recurrence is at or after 'alarmStart' time.
+        // Check if a repetition occurs between 'alarmStart' and 'to'.
+        bool found;
+        if (snoozeTime.isDaily()) {
+            Duration toFromDuration(dt, base);
+            int toFrom = toFromDuration.asDays();
+            found = snoozeTime.end(from) <= to ||
+                    (toFromDuration.isDaily() && toFrom % snooze == 0) ||
+                    (toFrom / snooze + 1) * snooze <= toFrom + period.asDays();
+        } else {
+            int toFrom = dt.secsTo(base);
+            found = period.asSeconds() >= snooze ||
+                    toFrom % snooze == 0 ||
+                    (toFrom / snooze + 1) * snooze <= toFrom + period.asSeconds();
+        }
+        if (found) {
+            // The first repetition of this recurrence's alarm from 'from' on
+            const QDateTime at = endOffset.end(offset.end(dt));
+            trigger = at;
+            for (int repetition = 1; trigger < from && repetition <= a->repeatCount(); ++repetition) {
+                trigger = snoozeTime.isDaily() ? at.addDays(qint64(repetition) * snooze)
+                          : at.addSecs(qint64(repetition) * snooze);
             }
-            qCDebug(KCALCORE_LOG) << incidence->summary() << "':" << dt.toString();
-            alarms.append(a);
+            occurrence = dt;
+            return true;
         }
     }
+    return false;
+}
+
+AlarmOccurrence::List Calendar::alarmOccurrences(const QDateTime &from, const QDateTime &to) const
+{
+    AlarmOccurrence::List occurrences;
+    QDateTime trigger;
+    QDateTime occurrence;
+    const QDateTime preTime = from.addSecs(-1);
+    forEachIncidence([&](const Incidence::Ptr &incidence) {
+        // Same incidences as MemoryCalendar::alarms()
+        if (incidence->type() == Incidence::TypeJournal ||
+                (incidence->type() == Incidence::TypeTodo && incidence.staticCast<Todo>()->isCompleted())) {
+            return;
+        }
+
+        const Alarm::List alarms = incidence->alarms();
+        for (const Alarm::Ptr &alarm : alarms) {
+            if (!alarm->enabled()) {
+                continue;
+            }
+            if (incidence->recurs()) {
+                if (Private::recurringAlarmTrigger(incidence, alarm, from, to, trigger, occurrence)) {
+                    occurrences.append(AlarmOccurrence(alarm, incidence, occurrence, trigger));
+                }
+            } else {
+                trigger = alarm->nextRepetition(preTime);
+                if (trigger.isValid() && trigger <= to) {
+                    occurrences.append(AlarmOccurrence(alarm, incidence, incidence->recurrenceId(), trigger));
+                }
+            }
+        }
+    });
+
+    std::stable_sort(occurrences.begin(), occurrences.end(),
+    [](const AlarmOccurrence &a, const AlarmOccurrence &b) {
+        return a.triggerTime() < b.triggerTime();
+    });
+    return occurrences;
 }
 
 void Calendar::startBatchAdding()
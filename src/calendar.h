@@ -49,6 +49,7 @@ This API needs serious cleaning up:
 #define KCALCORE_CALENDAR_H
 
 #include "kcalendarcore_export.h"
+#include "alarmoccurrence.h"
 #include "event.h"
 #include "customproperties.h"
 #include "incidence.h"
@@ -59,6 +60,8 @@ This API needs serious cleaning up:
 #include <QDateTime>
 #include <QTimeZone>
 
+#include <functional>
+
 /** Namespace for all KCalendarCore types. */
 namespace KCalendarCore
 {
@@ -336,6 +339,47 @@ public:
     */
     Q_REQUIRED_RESULT bool batchAdding() const;
 
+    /**
+      Inserts many incidences into the calendar at once.
+
+      Calendars which support it build their indexes in one pass, set up
+      the relations between the incidences once all of them are inserted,
+      and notify each BatchObserver with a single call. The others get
+      each incidence added with addIncidence().
+
+      @note Calendars may insert the incidences without calling
+      addIncidence() for each of them.
+
+      @param incidences are the incidences to insert.
+      @return true if all of the incidences were inserted; false otherwise.
+      @see addIncidence(), BatchObserver
+      @since 5.64
+    */
+    bool addIncidences(const Incidence::List &incidences);
+
+    /**
+      Starts collecting the changes made to incidences of this calendar.
+
+      Until the matching endBatchChanges(), observers are not told about
+      changed incidences. Each incidence changed in between is reported
+      once by endBatchChanges(), with the fields changed by all of its
+      updates in its dirtyFields(). Incidences deleted in between are not
+      reported as changed. Calls may be nested.
+
+      @see endBatchChanges(), BatchObserver
+      @since 5.64
+    */
+    void startBatchChanges();
+
+    /**
+      Ends collecting the changes made to incidences of this calendar, and
+      notifies the observers of them when the outermost batch ends.
+
+      @see startBatchChanges()
+      @since 5.64
+    */
+    void endBatchChanges();
+
     /**
       Inserts an Incidence into the calendar.
 
@@ -381,6 +425,31 @@ public:
     */
     virtual Incidence::List rawIncidences() const;
 
+    /**
+      Calls @p func for every Event, Todo and Journal of this Calendar,
+      unfiltered and in no particular order.
+
+      Unlike rawIncidences(), this builds no list of the incidences, which
+      saves time and memory on large calendars. @p func must not add or
+      delete incidences.
+
+      @param func is the function to call for each incidence.
+      @since 5.64
+    */
+    void forEachIncidence(const std::function<void(const Incidence::Ptr &)> &func) const;
+
+    /**
+      Calls @p func for every incidence of type @p type of this Calendar,
+      unfiltered and in no particular order.
+
+      @param type is the type of the incidences.
+      @param func is the function to call for each incidence.
+      @see forEachIncidence(const std::function<void(const Incidence::Ptr &)> &)
+      @since 5.64
+    */
+    void forEachIncidence(IncidenceBase::IncidenceType type,
+                          const std::function<void(const Incidence::Ptr &)> &func) const;
+
     /**
       Returns an unfiltered list of all exceptions of this recurring incidence.
 
@@ -507,11 +576,28 @@ public:
     /**
       List all possible duplicate incidences.
 
+      Duplicates are the incidences associated to a notebook which have the
+      same start and summary as @p incidence.
+
       @param incidence is the incidence to check.
       @return a list of duplicate incidences.
     */
     virtual Incidence::List duplicates(const Incidence::Ptr &incidence);
 
+    /**
+      List all possible duplicate incidences of many incidences at once,
+      such as the incidences of an import.
+
+      The time taken grows linearly with the number of @p incidences.
+
+      @param incidences are the incidences to check.
+      @return a list of duplicate incidences for every incidence, in the
+      order of @p incidences.
+      @see duplicates(const Incidence::Ptr &)
+      @since 5.64
+    */
+    Q_REQUIRED_RESULT QVector<Incidence::List> duplicates(const Incidence::List &incidences);
+
     /**
       Returns the Incidence associated with the given unique identifier.
 
@@ -1153,12 +1239,26 @@ public:
     /**
       Checks if @p ancestor is an ancestor of @p incidence
 
+      This takes time proportional to the depth of @p incidence in the
+      hierarchy.
+
       @param ancestor is the incidence we are testing to be an ancestor.
       @param incidence is the incidence we are testing to be descended from @p ancestor.
     */
     bool isAncestorOf(const Incidence::Ptr &ancestor,
                       const Incidence::Ptr &incidence) const;
 
+    /**
+       Returns the UIDs of the ancestors of incidence @p uid in this
+       calendar: its parent first, then the parent of that one, and so on.
+       The chain ends at the first ancestor which is not in the calendar.
+
+       @param uid The identifier of the incidence whose ancestors we want to obtain.
+       @see isAncestorOf()
+       @since 5.64
+    */
+    Q_REQUIRED_RESULT QStringList ancestorUids(const QString &uid) const;
+
     /**
        Returns a list of incidences that have a relation of RELTYPE parent
        to incidence @p uid.
@@ -1167,6 +1267,18 @@ public:
     */
     Incidence::List relations(const QString &uid) const;
 
+    /**
+       Returns all incidences descending from incidence @p uid: its
+       children, their children, and so on, level by level.
+
+       This takes time proportional to the size of the returned list.
+
+       @param uid The identifier of the incidence whose subtree we want to obtain.
+       @see relations()
+       @since 5.64
+    */
+    Q_REQUIRED_RESULT Incidence::List descendants(const QString &uid) const;
+
     // Filter Specific Methods //
 
     /**
@@ -1203,6 +1315,25 @@ public:
     */
     virtual Alarm::List alarms(const QDateTime &from, const QDateTime &to, bool excludeBlockedAlarms = false) const = 0;
 
+    /**
+      Returns the triggers of alarms within a time range for this Calendar.
+
+      Unlike alarms(), this also returns the time each alarm triggers and
+      the occurrence of its incidence it triggers for, as found while
+      searching the recurrences. Callers need not search them again with
+      Alarm::nextTime() or Alarm::nextRepetition().
+
+      Enabled alarms of all events and uncompleted to-dos are considered,
+      each of them returned at most once, with its first trigger in the
+      time range. The result is sorted by trigger time.
+
+      @param from is the starting timestamp.
+      @param to is the ending timestamp.
+      @return the list of alarm triggers in the specified time range.
+      @since 5.64
+    */
+    Q_REQUIRED_RESULT AlarmOccurrence::List alarmOccurrences(const QDateTime &from, const QDateTime &to) const;
+
     // Observer Specific Methods //
 
     /**
@@ -1261,6 +1392,40 @@ public:
         virtual void calendarIncidenceAdditionCanceled(const Incidence::Ptr &incidence);
     };
 
+    /**
+      @class BatchObserver
+
+      An interface for CalendarObservers that want to hear about many
+      changes at once. A registered CalendarObserver which also inherits
+      BatchObserver is told about incidences inserted with addIncidences(),
+      and about incidences changed between startBatchChanges() and
+      endBatchChanges(), by a single call instead of one call per incidence.
+
+      @since 5.64
+    */
+    class KCALENDARCORE_EXPORT BatchObserver //krazy:exclude=dpointer
+    {
+    public:
+        /**
+          Destructor.
+        */
+        virtual ~BatchObserver();
+
+        /**
+          Notify the Observer that Incidences have been inserted.
+          This replaces calendarIncidenceAdded() for each of them.
+          @param incidences are the Incidences that were inserted.
+        */
+        virtual void calendarIncidencesAdded(const Incidence::List &incidences) = 0;
+
+        /**
+          Notify the Observer that Incidences have been modified.
+          This replaces calendarIncidenceChanged() for each of them.
+          @param incidences are the Incidences that were modified.
+        */
+        virtual void calendarIncidencesChanged(const Incidence::List &incidences) = 0;
+    };
+
     /**
       Registers an Observer for this Calendar.
 
@@ -1304,12 +1469,26 @@ protected:
     */
     void notifyIncidenceAdded(const Incidence::Ptr &incidence);
 
+    /**
+      Let Calendar subclasses notify that they inserted many Incidences.
+      @param incidences are the Incidence objects that were inserted.
+      @since 5.64
+    */
+    void notifyIncidencesAdded(const Incidence::List &incidences);
+
     /**
       Let Calendar subclasses notify that they modified an Incidence.
       @param incidence is a pointer to the Incidence object that was modified.
     */
     void notifyIncidenceChanged(const Incidence::Ptr &incidence);
 
+    /**
+      Let Calendar subclasses notify that they modified many Incidences.
+      @param incidences are the Incidence objects that were modified.
+      @since 5.64
+    */
+    void notifyIncidencesChanged(const Incidence::List &incidences);
+
     /**
       Let Calendar subclasses notify that they will remove an Incidence.
       @param incidence is a pointer to the Incidence object that will be removed.
@@ -1398,6 +1577,8 @@ Q_SIGNALS:
 
 private:
     friend class ICalFormat;
+    friend class ICalFormatImpl;
+    friend class MemoryCalendar;
 
     //@cond PRIVATE
     class Private;
@@ -28,6 +28,8 @@
 #include "calendar.h"
 #include "calfilter.h"
 
+#include <functional>
+
 namespace KCalendarCore {
 
 /**
@@ -62,6 +64,17 @@ public:
         delete mDefaultFilter;
     }
     QTimeZone timeZoneIdSpec(const QByteArray &timeZoneId);
+    void addTimeZones(const Incidence::Ptr &incidence);
+    static bool recurringAlarmTrigger(const Incidence::Ptr &incidence, const Alarm::Ptr &a,
+                                      const QDateTime &from, const QDateTime &to,
+                                      QDateTime &trigger, QDateTime &occurrence);
+    static QPair<qint64, QString> contentKey(const Incidence::Ptr &incidence);
+    void indexContent(const Incidence::Ptr &incidence);
+    void unindexContent(const Incidence::Ptr &incidence);
+    void fileRelation(const Incidence::Ptr &incidence, const QString &parentUid);
+    void unfileRelation(const Incidence::Ptr &incidence);
+    void queueChange(const Incidence::Ptr &incidence);
+    void dropChange(const Incidence::Ptr &incidence);
 
     QString mProductId;
     Person mOwner;
@@ -75,17 +88,43 @@ public:
     CalFilter *mDefaultFilter = nullptr;
     CalFilter *mFilter = nullptr;
 
-    // These lists are used to put together related To-dos
-    QMultiHash<QString, Incidence::Ptr> mOrphans;
-    QMultiHash<QString, Incidence::Ptr> mOrphanUids;
-
     // Lists for associating incidences to notebooks
     QMultiHash<QString, Incidence::Ptr > mNotebookIncidences;
     QHash<QString, QString> mUidToNotebook;
     QHash<QString, bool> mNotebooks; // name to visibility
     QHash<Incidence::Ptr, bool> mIncidenceVisibility; // incidence -> visibility
     QString mDefaultNotebook; // uid of default notebook
-    QMap<QString, Incidence::List > mIncidenceRelations;
+    // Incidences associated to notebooks, indexed by start and summary to
+    // find duplicates
+    QMultiHash<QPair<qint64, QString>, Incidence::Ptr> mIncidencesByContent;
+    QHash<Incidence::Ptr, QPair<qint64, QString>> mContentKeys;
+    // The relation graph: the incidences related to a UID, whether an
+    // incidence with that UID is in the calendar or is still to come, where
+    // each of them is filed in there, and the related-to UID of every
+    // incidence in the calendar
+    struct RelationFiling {
+        QString parentUid;
+        int index;
+    };
+    QHash<QString, Incidence::List> mIncidenceRelations;
+    QHash<Incidence::Ptr, RelationFiling> mRelationFilings;
+    QHash<QString, QString> mParentUids;
+    // Changes collected between startBatchChanges() and endBatchChanges(),
+    // in the order the incidences were first changed, and where each
+    // incidence is in there. The uid or recurrence ID may change within
+    // the batch, so this goes by the incidence itself
+    struct PendingChange {
+        Incidence::Ptr incidence;
+        QSet<IncidenceBase::Field> dirtyFields;
+    };
+    QVector<PendingChange> mPendingChanges;
+    QHash<Incidence::Ptr, int> mPendingChangeIndex;
+    int mBatchChangeDepth = 0;
+    // Direct access to the storage of a MemoryCalendar, unset when the
+    // calendar is not one or reimplements the functions they replace
+    std::function<void(IncidenceBase::IncidenceType,
+                       const std::function<void(const Incidence::Ptr &)> &)> mForEachIncidence;
+    std::function<bool(const Incidence::List &)> mInsertIncidences;
     bool batchAddingInProgress = false;
     bool mDeletionTracking = false;
 };
@@ -39,6 +39,9 @@
 #include "kcalendarcore_debug.h"
 #include <QTime>
 
+#include <algorithm>
+#include <iterator>
+
 using namespace KCalendarCore;
 
 //@cond PRIVATE
@@ -64,6 +67,10 @@ public:
 
     QDateTime mDtEnd;                  // end datetime
     FreeBusyPeriod::List mBusyPeriods; // list of periods
+    bool mNormalized = false;          // periods are kept coalesced
+
+    void addPeriods(const FreeBusyPeriod::List &periods);
+    void insertNormalized(FreeBusyPeriod::List periods);
 
     // This is used for creating a freebusy object for the current user
     bool addLocalPeriod(FreeBusy *fb, const QDateTime &start, const QDateTime &end);
@@ -73,6 +80,58 @@ void KCalendarCore::FreeBusy::Private::init(const KCalendarCore::FreeBusy::Priva
 {
     mDtEnd = other.mDtEnd;
     mBusyPeriods = other.mBusyPeriods;
+    mNormalized = other.mNormalized;
+}
+
+void KCalendarCore::FreeBusy::Private::addPeriods(const FreeBusyPeriod::List &periods)
+{
+    if (mNormalized) {
+        insertNormalized(periods);
+    } else {
+        mBusyPeriods += periods;
+        q->sortList();
+    }
+}
+
+// Returns @p period lasting until @p end instead.
+static FreeBusyPeriod extendedPeriod(const FreeBusyPeriod &period, const QDateTime &end)
+{
+    FreeBusyPeriod extended(period.start(), end);
+    extended.setType(period.type());
+    extended.setSummary(period.summary());
+    extended.setLocation(period.location());
+    return extended;
+}
+
+void KCalendarCore::FreeBusy::Private::insertNormalized(FreeBusyPeriod::List periods)
+{
+    // The busy periods are sorted already, so only the new ones need sorting
+    // before both lists are merged.
+    std::sort(periods.begin(), periods.end());
+    FreeBusyPeriod::List sorted;
+    sorted.reserve(mBusyPeriods.count() + periods.count());
+    std::merge(mBusyPeriods.constBegin(), mBusyPeriods.constEnd(),
+               periods.constBegin(), periods.constEnd(),
+               std::back_inserter(sorted));
+
+    // Coalesce overlapping and adjacent periods of the same type in one sweep,
+    // remembering the last period kept for every type.
+    int last[FreeBusyPeriod::Unknown + 1];
+    std::fill(std::begin(last), std::end(last), -1);
+    FreeBusyPeriod::List coalesced;
+    coalesced.reserve(sorted.count());
+    for (const FreeBusyPeriod &period : qAsConst(sorted)) {
+        int &index = last[qBound<int>(FreeBusyPeriod::Free, period.type(), FreeBusyPeriod::Unknown)];
+        if (index >= 0 && period.start() <= coalesced.at(index).end()) {
+            if (period.end() > coalesced.at(index).end()) {
+                coalesced[index] = extendedPeriod(coalesced.at(index), period.end());
+            }
+        } else {
+            index = coalesced.count();
+            coalesced.append(period);
+        }
+    }
+    mBusyPeriods = coalesced;
 }
 //@endcond
 
@@ -104,90 +163,85 @@ FreeBusy::FreeBusy(const Event::List &events, const QDateTime &start, const QDat
 }
 
 //@cond PRIVATE
+// Returns the busy time of the occurrence of an event starting at 'occurrence'.
+// All-day events take up the whole of their days.
+static void occurrencePeriod(const Event::Ptr &event, const QDateTime &occurrence,
+                             QDateTime &start, QDateTime &end)
+{
+    start = occurrence;
+    if (event->allDay()) {
+        start.setTime(QTime(0, 0));
+        end = start;
+        end.setDate(start.date().addDays(event->dtStart().date().daysTo(event->dtEnd().date())));
+        end.setTime(QTime(23, 59, 59, 999));
+    } else {
+        const QDateTime dtEnd = event->dtEnd();
+        end = occurrence.addMSecs(dtEnd.isValid() ? qMax<qint64>(0, event->dtStart().msecsTo(dtEnd)) : 0);
+    }
+}
+
 void FreeBusy::Private::init(const Event::List &eventList,
                              const QDateTime &start, const QDateTime &end)
 {
-    qint64 extraDays;
-    int i;
-    int x;
-    qint64 duration = start.daysTo(end);
-    QDate day;
-    QDateTime tmpStart;
-    QDateTime tmpEnd;
+    QDateTime periodStart;
+    QDateTime periodEnd;
 
     // Loops through every event in the calendar
-    Event::List::ConstIterator it;
-    for (it = eventList.constBegin(); it != eventList.constEnd(); ++it) {
-        Event::Ptr event = *it;
-
+    for (const Event::Ptr &event : eventList) {
         // If this event is transparent it shouldn't be in the freebusy list.
         if (event->transparency() == Event::Transparent) {
             continue;
         }
 
-        // The code below can not handle all-day events. Fixing this resulted
-        // in a lot of duplicated code. Instead, make a copy of the event and
-        // set the period to the full day(s). This trick works for recurring,
-        // multiday, and single day all-day events.
-        Event::Ptr allDayEvent;
-        if (event->allDay()) {
-            // addDay event. Do the hack
-            qCDebug(KCALCORE_LOG) << "All-day event";
-            allDayEvent = Event::Ptr(new Event(*event));
-
-            // Set the start and end times to be on midnight
-            QDateTime st = allDayEvent->dtStart();
-            st.setTime(QTime(0, 0));
-            QDateTime nd = allDayEvent->dtEnd();
-            nd.setTime(QTime(23, 59, 59, 999));
-            allDayEvent->setAllDay(false);
-            allDayEvent->setDtStart(st);
-            allDayEvent->setDtEnd(nd);
-
-            qCDebug(KCALCORE_LOG) << "Use:" << st.toString() << "to" << nd.toString();
-            // Finally, use this event for the setting below
-            event = allDayEvent;
+        if (!event->recurs()) {
+            occurrencePeriod(event, event->dtStart(), periodStart, periodEnd);
+            addLocalPeriod(q, periodStart, periodEnd);
+            continue;
         }
 
-        // This whole for loop is for recurring events, it loops through
-        // each of the days of the freebusy request
-
-        for (i = 0; i <= duration; ++i) {
-            day = start.addDays(i).date();
-            tmpStart.setDate(day);
-            tmpEnd.setDate(day);
-
-            if (event->recurs()) {
-                if (event->isMultiDay()) {
-                    // FIXME: This doesn't work for sub-daily recurrences or recurrences with
-                    //        a different time than the original event.
-                    extraDays = event->dtStart().daysTo(event->dtEnd());
-                    for (x = 0; x <= extraDays; ++x) {
-                        if (event->recursOn(day.addDays(-x), start.timeZone())) {
-                            tmpStart.setDate(day.addDays(-x));
-                            tmpStart.setTime(event->dtStart().time());
-                            tmpEnd = event->duration().end(tmpStart);
-
-                            addLocalPeriod(q, tmpStart, tmpEnd);
-                            break;
-                        }
-                    }
-                } else {
-                    if (event->recursOn(day, start.timeZone())) {
-                        tmpStart.setTime(event->dtStart().time());
-                        tmpEnd.setTime(event->dtEnd().time());
-
-                        addLocalPeriod(q, tmpStart, tmpEnd);
-                    }
+        // Occurrences starting before the request may last into it
+        occurrencePeriod(event, event->dtStart(), periodStart, periodEnd);
+        QDateTime from = start.addMSecs(-periodStart.msecsTo(periodEnd));
+        const Recurrence *recurrence = event->recurrence();
+        // timesInInterval() cuts long lists short, and does not always mark
+        // them as incomplete, so keep asking for the rest until there is none
+        while (from.isValid() && from <= end) {
+            QDateTime last;
+            const QList<QDateTime> times = recurrence->timesInInterval(from, end);
+            for (const QDateTime &time : times) {
+                if (time.isValid()) {
+                    occurrencePeriod(event, time, periodStart, periodEnd);
+                    addLocalPeriod(q, periodStart, periodEnd);
+                    last = time;
                 }
             }
+            if (last.isValid()) {
+                from = last.addSecs(1);
+                continue;
+            }
+            // All the times of a list cut short may have been exceptions
+            const QDateTime next = recurrence->getNextDateTime(from.addSecs(-1));
+            if (!next.isValid() || next <= from) {
+                break;
+            }
+            from = next;
         }
-
-        // Non-recurring events
-        addLocalPeriod(q, event->dtStart(), event->dtEnd());
     }
 
+    // Merge overlapping periods in one sweep over the sorted list
     q->sortList();
+    FreeBusyPeriod::List merged;
+    merged.reserve(mBusyPeriods.count());
+    for (const FreeBusyPeriod &period : qAsConst(mBusyPeriods)) {
+        if (!merged.isEmpty() && period.start() <= merged.last().end()) {
+            if (period.end() > merged.last().end()) {
+                merged.last() = FreeBusyPeriod(merged.last().start(), period.end());
+            }
+        } else {
+            merged.append(period);
+        }
+    }
+    mBusyPeriods = merged;
 }
 //@endcond
 
@@ -257,29 +311,27 @@ void FreeBusy::sortList()
 
 void FreeBusy::addPeriods(const Period::List &list)
 {
-    d->mBusyPeriods.reserve(d->mBusyPeriods.count() + list.count());
+    FreeBusyPeriod::List periods;
+    periods.reserve(list.count());
     for (const Period &p : qAsConst(list)) {
-        d->mBusyPeriods << FreeBusyPeriod(p);
+        periods << FreeBusyPeriod(p);
     }
-    sortList();
+    d->addPeriods(periods);
 }
 
 void FreeBusy::addPeriods(const FreeBusyPeriod::List &list)
 {
-    d->mBusyPeriods += list;
-    sortList();
+    d->addPeriods(list);
 }
 
 void FreeBusy::addPeriod(const QDateTime &start, const QDateTime &end)
 {
-    d->mBusyPeriods.append(FreeBusyPeriod(start, end));
-    sortList();
+    d->addPeriods(FreeBusyPeriod::List{FreeBusyPeriod(start, end)});
 }
 
 void FreeBusy::addPeriod(const QDateTime &start, const Duration &duration)
 {
-    d->mBusyPeriods.append(FreeBusyPeriod(start, duration));
-    sortList();
+    d->addPeriods(FreeBusyPeriod::List{FreeBusyPeriod(start, duration)});
 }
 
 void FreeBusy::merge(const FreeBusy::Ptr &freeBusy)
@@ -292,6 +344,11 @@ void FreeBusy::merge(const FreeBusy::Ptr &freeBusy)
         setDtEnd(freeBusy->dtEnd());
     }
 
+    if (d->mNormalized) {
+        d->insertNormalized(freeBusy->fullBusyPeriods());
+        return;
+    }
+
     Period::List periods = freeBusy->busyPeriods();
     Period::List::ConstIterator it;
     d->mBusyPeriods.reserve(d->mBusyPeriods.count() + periods.count());
@@ -301,6 +358,52 @@ void FreeBusy::merge(const FreeBusy::Ptr &freeBusy)
     sortList();
 }
 
+void FreeBusy::setNormalized(bool normalized)
+{
+    if (normalized == d->mNormalized) {
+        return;
+    }
+    d->mNormalized = normalized;
+    if (normalized) {
+        const FreeBusyPeriod::List periods = d->mBusyPeriods;
+        d->mBusyPeriods.clear();
+        d->insertNormalized(periods);
+    }
+}
+
+bool FreeBusy::isNormalized() const
+{
+    return d->mNormalized;
+}
+
+Period::List FreeBusy::freePeriods(const QDateTime &start, const QDateTime &end) const
+{
+    FreeBusyPeriod::List periods = d->mBusyPeriods;
+    if (!d->mNormalized) {
+        std::sort(periods.begin(), periods.end());
+    }
+
+    Period::List res;
+    QDateTime freeStart = start;
+    for (const FreeBusyPeriod &period : qAsConst(periods)) {
+        if (freeStart >= end || period.start() >= end) {
+            break;
+        }
+        if (period.type() == FreeBusyPeriod::Free || period.end() <= freeStart) {
+            continue;
+        }
+        if (period.start() > freeStart) {
+            res << Period(freeStart, period.start());
+        }
+        freeStart = period.end();
+    }
+    if (freeStart < end) {
+        res << Period(freeStart, end);
+    }
+
+    return res;
+}
+
 void FreeBusy::shiftTimes(const QTimeZone &oldZone, const QTimeZone &newZone)
 {
     if (oldZone.isValid() && newZone.isValid() && oldZone != newZone) {
@@ -369,13 +472,9 @@ bool FreeBusy::Private::addLocalPeriod(FreeBusy *fb,
     QDateTime tmpStart;
     QDateTime tmpEnd;
 
-    //Check to see if the start *or* end of the event is
-    //between the start and end of the freebusy dates.
+    //Check to see if the event overlaps the freebusy dates.
     QDateTime start = fb->dtStart();
-    if (!(((start.secsTo(eventStart) >= 0) &&
-            (eventStart.secsTo(mDtEnd) >= 0)) ||
-            ((start.secsTo(eventEnd) >= 0) &&
-             (eventEnd.secsTo(mDtEnd) >= 0)))) {
+    if (start.secsTo(eventEnd) < 0 || eventStart.secsTo(mDtEnd) < 0) {
         return false;
     }
 
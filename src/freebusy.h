@@ -209,10 +209,47 @@ public:
     /**
       Merges another free/busy into this free/busy.
 
+      If the free/busy is normalized, the periods of @p freebusy keep their
+      types and are coalesced with the periods already present.
+
       @param freebusy is a pointer to a valid FreeBusy object.
     */
     void merge(const FreeBusy::Ptr &freebusy);
 
+    /**
+      Sets whether the periods of the free/busy are kept normalized.
+
+      The periods of a normalized free/busy are sorted, and overlapping or
+      adjacent periods of the same type are coalesced into one, keeping the
+      summary and location of the earliest. Adding periods and merging then
+      cost linear time in the number of periods.
+
+      Enabling normalization coalesces the periods already present.
+
+      @param normalized if true, the periods are kept normalized.
+      @see isNormalized()
+      @since 5.64
+    */
+    void setNormalized(bool normalized);
+
+    /**
+      Returns true if the periods of the free/busy are kept normalized.
+      @see setNormalized()
+      @since 5.64
+    */
+    Q_REQUIRED_RESULT bool isNormalized() const;
+
+    /**
+      Returns the free periods between @p start and @p end, that is the parts
+      of that time not covered by any period except those of type
+      FreeBusyPeriod::Free. The periods are returned in ascending order.
+
+      @param start is the start of the time to search.
+      @param end is the end of the time to search.
+      @since 5.64
+    */
+    Q_REQUIRED_RESULT Period::List freePeriods(const QDateTime &start, const QDateTime &end) const;
+
     /**
       @copydoc
       IncidenceBase::dateTime()
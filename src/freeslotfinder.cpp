@@ -0,0 +1,267 @@
+/*
+  This file is part of the kcalcore library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with this library; see the file COPYING.LIB.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+/**
+  @file
+  This file is part of the API for handling calendar data and
+  defines the FreeSlotFinder class.
+*/
+
+#include "freeslotfinder.h"
+#include "kcalendarcore_debug.h"
+
+#include <algorithm>
+
+using namespace KCalendarCore;
+
+//@cond PRIVATE
+class Q_DECL_HIDDEN KCalendarCore::FreeSlotFinder::Private
+{
+public:
+    Private()
+        : mWorkingDays(7, true),
+          mTimeZone(QTimeZone::systemTimeZone())
+    {}
+
+    // The next busy period of one of the free/busy objects
+    struct Cursor {
+        qint64 start;
+        int list;
+        int index;
+    };
+
+    static bool laterCursor(const Cursor &a, const Cursor &b)
+    {
+        return a.start > b.start;
+    }
+
+    bool isRestricted() const
+    {
+        return mWorkingHoursStart.isValid() || mWorkingHoursEnd.isValid()
+               || mWorkingDays.count(true) < 7;
+    }
+
+    void addSlots(Period::List &freeSlots, int maxSlots, const QDateTime &origin,
+                  qint64 freeStart, qint64 freeEnd, qint64 length) const;
+
+    FreeBusy::List mFreeBusyList;
+    QTime mWorkingHoursStart;
+    QTime mWorkingHoursEnd;
+    QBitArray mWorkingDays;
+    QTimeZone mTimeZone;
+};
+
+// Adds the parts of the free time [freeStart, freeEnd) that lie in working
+// hours and last at least length milliseconds. Times are milliseconds since
+// the epoch, origin is the start of the search.
+void FreeSlotFinder::Private::addSlots(Period::List &freeSlots, int maxSlots, const QDateTime &origin,
+                                       qint64 freeStart, qint64 freeEnd, qint64 length) const
+{
+    const qint64 originMSecs = origin.toMSecsSinceEpoch();
+    const auto append = [&](qint64 start, qint64 end) {
+        if (end <= start || end - start < length) {
+            return true;
+        }
+        if (freeSlots.count() >= maxSlots) {
+            return false;
+        }
+        freeSlots << Period(origin.addMSecs(start - originMSecs), origin.addMSecs(end - originMSecs));
+        return true;
+    };
+
+    if (!isRestricted()) {
+        append(freeStart, freeEnd);
+        return;
+    }
+
+    const QTime dayStart = mWorkingHoursStart.isValid() ? mWorkingHoursStart : QTime(0, 0);
+    const QTime dayEnd = mWorkingHoursEnd.isValid() ? mWorkingHoursEnd : QTime(0, 0);
+    const bool overnight = dayEnd <= dayStart;
+
+    // Working time of consecutive days is joined, e.g. over midnight, before
+    // the length is checked
+    qint64 slotStart = 0;
+    qint64 slotEnd = 0;
+
+    // Working hours of the previous day may last into the free time
+    QDate date = QDateTime::fromMSecsSinceEpoch(freeStart, mTimeZone).date().addDays(-1);
+    for (;; date = date.addDays(1)) {
+        const qint64 workStart = QDateTime(date, dayStart, mTimeZone).toMSecsSinceEpoch();
+        if (workStart >= freeEnd) {
+            break;
+        }
+        if (!mWorkingDays.testBit(date.dayOfWeek() - 1)) {
+            continue;
+        }
+        const qint64 workEnd = QDateTime(overnight ? date.addDays(1) : date, dayEnd, mTimeZone).toMSecsSinceEpoch();
+        const qint64 start = std::max(workStart, freeStart);
+        const qint64 end = std::min(workEnd, freeEnd);
+        if (end <= start) {
+            continue;
+        }
+        if (start == slotEnd) {
+            slotEnd = end;
+            continue;
+        }
+        if (!append(slotStart, slotEnd)) {
+            return;
+        }
+        slotStart = start;
+        slotEnd = end;
+    }
+    append(slotStart, slotEnd);
+}
+//@endcond
+
+FreeSlotFinder::FreeSlotFinder()
+    : d(new KCalendarCore::FreeSlotFinder::Private())
+{
+}
+
+FreeSlotFinder::FreeSlotFinder(const FreeBusy::List &freeBusyList)
+    : d(new KCalendarCore::FreeSlotFinder::Private())
+{
+    d->mFreeBusyList = freeBusyList;
+}
+
+FreeSlotFinder::~FreeSlotFinder()
+{
+    delete d;
+}
+
+void FreeSlotFinder::setFreeBusyList(const FreeBusy::List &freeBusyList)
+{
+    d->mFreeBusyList = freeBusyList;
+}
+
+FreeBusy::List FreeSlotFinder::freeBusyList() const
+{
+    return d->mFreeBusyList;
+}
+
+void FreeSlotFinder::setWorkingHours(const QTime &start, const QTime &end)
+{
+    d->mWorkingHoursStart = start;
+    d->mWorkingHoursEnd = end;
+}
+
+QTime FreeSlotFinder::workingHoursStart() const
+{
+    return d->mWorkingHoursStart;
+}
+
+QTime FreeSlotFinder::workingHoursEnd() const
+{
+    return d->mWorkingHoursEnd;
+}
+
+void FreeSlotFinder::setWorkingDays(const QBitArray &days)
+{
+    if (days.size() != 7) {
+        qCWarning(KCALCORE_LOG) << "Invalid working days, expected 7 days but got" << days.size();
+        return;
+    }
+    d->mWorkingDays = days;
+}
+
+QBitArray FreeSlotFinder::workingDays() const
+{
+    return d->mWorkingDays;
+}
+
+void FreeSlotFinder::setTimeZone(const QTimeZone &timeZone)
+{
+    d->mTimeZone = timeZone;
+}
+
+QTimeZone FreeSlotFinder::timeZone() const
+{
+    return d->mTimeZone;
+}
+
+Period::List FreeSlotFinder::findSlots(const QDateTime &start, const QDateTime &end,
+                                       const Duration &duration, int maxSlots) const
+{
+    Period::List freeSlots;
+    const qint64 length = duration.asSeconds() * qint64(1000);
+    if (!start.isValid() || !end.isValid() || start >= end || length < 0 || maxSlots <= 0) {
+        return freeSlots;
+    }
+
+    // The busy periods of every free/busy object, sorted by start
+    QVector<FreeBusyPeriod::List> lists;
+    lists.reserve(d->mFreeBusyList.count());
+    for (const FreeBusy::Ptr &freeBusy : qAsConst(d->mFreeBusyList)) {
+        if (!freeBusy) {
+            continue;
+        }
+        FreeBusyPeriod::List periods = freeBusy->fullBusyPeriods();
+        if (periods.isEmpty()) {
+            continue;
+        }
+        if (!std::is_sorted(periods.constBegin(), periods.constEnd())) {
+            std::sort(periods.begin(), periods.end());
+        }
+        lists.append(periods);
+    }
+
+    // Min-heap holding the next busy period of every list
+    QVector<Private::Cursor> heap;
+    heap.reserve(lists.count());
+    for (int i = 0; i < lists.count(); ++i) {
+        heap.append(Private::Cursor{lists.at(i).first().start().toMSecsSinceEpoch(), i, 0});
+    }
+    std::make_heap(heap.begin(), heap.end(), Private::laterCursor);
+
+    const qint64 endMSecs = end.toMSecsSinceEpoch();
+    qint64 freeStart = start.toMSecsSinceEpoch();
+    while (freeStart < endMSecs && freeSlots.count() < maxSlots) {
+        // Take the busy periods in ascending order of start until one of them
+        // ends after the free time began
+        qint64 busyStart = endMSecs;
+        qint64 busyEnd = endMSecs;
+        while (!heap.isEmpty()) {
+            std::pop_heap(heap.begin(), heap.end(), Private::laterCursor);
+            Private::Cursor cursor = heap.takeLast();
+            const FreeBusyPeriod::List &periods = lists.at(cursor.list);
+            const FreeBusyPeriod &period = periods.at(cursor.index);
+            const qint64 periodStart = cursor.start;
+            if (++cursor.index < periods.count()) {
+                cursor.start = periods.at(cursor.index).start().toMSecsSinceEpoch();
+                heap.append(cursor);
+                std::push_heap(heap.begin(), heap.end(), Private::laterCursor);
+            }
+            if (period.type() == FreeBusyPeriod::Free) {
+                continue;
+            }
+            const qint64 periodEnd = period.end().toMSecsSinceEpoch();
+            if (periodEnd > freeStart) {
+                busyStart = std::min(periodStart, endMSecs);
+                busyEnd = periodEnd;
+                break;
+            }
+        }
+
+        if (busyStart > freeStart) {
+            d->addSlots(freeSlots, maxSlots, start, freeStart, busyStart, length);
+        }
+        freeStart = busyEnd;
+    }
+
+    return freeSlots;
+}
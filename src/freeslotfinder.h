@@ -0,0 +1,180 @@
+/*
+  This file is part of the kcalcore library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with this library; see the file COPYING.LIB.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+/**
+  @file
+  This file is part of the API for handling calendar data and
+  defines the FreeSlotFinder class.
+
+  @brief
+  Finds the common free time of several free/busy objects.
+*/
+
+#ifndef KCALCORE_FREESLOTFINDER_H
+#define KCALCORE_FREESLOTFINDER_H
+
+#include "kcalendarcore_export.h"
+#include "duration.h"
+#include "freebusy.h"
+#include "period.h"
+
+#include <QBitArray>
+#include <QTime>
+#include <QTimeZone>
+
+namespace KCalendarCore
+{
+
+/**
+  @brief
+  Finds the common free time of several free/busy objects.
+
+  This class is used to schedule a meeting: given the free/busy of every
+  attendee, it returns the periods in which all of them are free, optionally
+  restricted to working hours and working days.
+
+  The busy periods of all free/busy objects are walked together in a single
+  merge, so finding the free time costs O(P log N) for N free/busy objects
+  with P busy periods in total.
+
+  @code
+  FreeSlotFinder finder(freeBusyList);
+  finder.setWorkingHours(QTime(9, 0), QTime(17, 0));
+  const Period::List freeSlots = finder.findSlots(start, end, Duration(3600), 3);
+  @endcode
+
+  @since 5.64
+*/
+class KCALENDARCORE_EXPORT FreeSlotFinder
+{
+public:
+    /**
+      Constructs a finder without any free/busy objects.
+    */
+    FreeSlotFinder();
+
+    /**
+      Constructs a finder for the given free/busy objects.
+      @param freeBusyList is the list of free/busy objects, one per attendee.
+    */
+    explicit FreeSlotFinder(const FreeBusy::List &freeBusyList);
+
+    /**
+      Destroys the finder.
+    */
+    ~FreeSlotFinder();
+
+    /**
+      Sets the free/busy objects whose common free time is searched.
+      @param freeBusyList is the list of free/busy objects, one per attendee.
+      @see freeBusyList()
+    */
+    void setFreeBusyList(const FreeBusy::List &freeBusyList);
+
+    /**
+      Returns the free/busy objects whose common free time is searched.
+      @see setFreeBusyList()
+    */
+    Q_REQUIRED_RESULT FreeBusy::List freeBusyList() const;
+
+    /**
+      Restricts the free time to the working hours of every working day.
+      If @p end is not after @p start, the working hours last until @p end
+      on the next day. Invalid times mean the start or the end of the day.
+
+      By default there are no working hours, the whole day may be used.
+
+      @param start is the time the working hours begin.
+      @param end is the time the working hours end.
+      @see workingHoursStart(), workingHoursEnd(), setTimeZone()
+    */
+    void setWorkingHours(const QTime &start, const QTime &end);
+
+    /**
+      Returns the time the working hours begin.
+      @see setWorkingHours()
+    */
+    Q_REQUIRED_RESULT QTime workingHoursStart() const;
+
+    /**
+      Returns the time the working hours end.
+      @see setWorkingHours()
+    */
+    Q_REQUIRED_RESULT QTime workingHoursEnd() const;
+
+    /**
+      Restricts the free time to the given days of the week.
+
+      By default every day is a working day.
+
+      @param days is a bit array of size 7 with the bit of every working day
+      set, Monday being the first bit.
+      @see workingDays()
+    */
+    void setWorkingDays(const QBitArray &days);
+
+    /**
+      Returns the working days, Monday being the first bit.
+      @see setWorkingDays()
+    */
+    Q_REQUIRED_RESULT QBitArray workingDays() const;
+
+    /**
+      Sets the time zone the working hours and days are given in.
+      The system time zone is used by default.
+
+      @param timeZone is the time zone of the working hours.
+      @see timeZone()
+    */
+    void setTimeZone(const QTimeZone &timeZone);
+
+    /**
+      Returns the time zone the working hours and days are given in.
+      @see setTimeZone()
+    */
+    Q_REQUIRED_RESULT QTimeZone timeZone() const;
+
+    /**
+      Returns the first periods between @p start and @p end in which all the
+      free/busy objects are free, within the working hours and working days.
+
+      Every period returned is as long as possible and lasts at least
+      @p duration; a meeting may start anywhere within the period as long
+      as it ends in the period as well. Periods of type FreeBusyPeriod::Free
+      do not count as busy. The periods are returned in ascending order, in
+      the time zone of @p start.
+
+      @param start is the start of the time to search.
+      @param end is the end of the time to search.
+      @param duration is the minimum length of the periods.
+      @param maxSlots is the maximum number of periods to return.
+    */
+    Q_REQUIRED_RESULT Period::List findSlots(const QDateTime &start, const QDateTime &end,
+                                             const Duration &duration, int maxSlots = 1) const;
+
+private:
+    //@cond PRIVATE
+    Q_DISABLE_COPY(FreeSlotFinder)
+    class Private;
+    Private *const d;
+    //@endcond
+};
+
+}
+
+#endif
@@ -36,7 +36,9 @@
 #include "kcalendarcore_debug.h"
 #include "calendar_p.h"
 
+#include <QBuffer>
 #include <QSaveFile>
+#include <QThread>
 #include <QFile>
 #include <QTimeZone>
 
@@ -62,9 +64,125 @@ public:
     {
         delete mImpl;
     }
+    bool writeCalendar(const Calendar::Ptr &cal, QIODevice *device,
+                       const QString &notebook, bool deleted,
+                       const QVector<QTimeZone> &allTimeZones);
+
     ICalFormatImpl *mImpl = nullptr;
     QTimeZone mTimeZone;
+    int mLoadThreadCount = 1;
 };
+
+// Writes every component to the device as soon as it has been created, so
+// that the serialized calendar never needs to be held in memory as a whole.
+bool ICalFormat::Private::writeCalendar(const Calendar::Ptr &cal, QIODevice *device,
+                                        const QString &notebook, bool deleted,
+                                        const QVector<QTimeZone> &allTimeZones)
+{
+    const auto writeComponent = [device](icalcomponent *component) {
+        char *const componentString = icalcomponent_as_ical_string_r(component);
+        const qint64 length = qstrlen(componentString);
+        const bool success = device->write(componentString, length) == length;
+        free(componentString);
+        icalcomponent_free(component);
+        return success;
+    };
+
+    // The calendar properties, without the closing END:VCALENDAR
+    icalcomponent *calendar = mImpl->createCalendarComponent(cal);
+    char *const calendarString = icalcomponent_as_ical_string_r(calendar);
+    QByteArray header(calendarString);
+    free(calendarString);
+    icalcomponent_free(calendar);
+    header.truncate(header.lastIndexOf("END:VCALENDAR"));
+    if (header.isEmpty() || device->write(header) != header.size()) {
+        return false;
+    }
+
+    QVector<QTimeZone> tzUsedList;
+    TimeZoneEarliestDate earliestTz;
+
+    bool allWritten = true;
+    bool hasIncidences = false;
+    const auto writeIncidence = [&](const Incidence::Ptr &incidence) {
+        hasIncidences = true;
+        if (!allWritten) {
+            return;
+        }
+        if (notebook.isEmpty() ||
+                (!cal->notebook(incidence).isEmpty() && notebook.endsWith(cal->notebook(incidence)))) {
+            icalcomponent *component = nullptr;
+            switch (incidence->type()) {
+            case Incidence::TypeTodo:
+                component = mImpl->writeTodo(incidence.staticCast<Todo>(), &tzUsedList);
+                break;
+            case Incidence::TypeEvent:
+                component = mImpl->writeEvent(incidence.staticCast<Event>(), &tzUsedList);
+                break;
+            case Incidence::TypeJournal:
+                component = mImpl->writeJournal(incidence.staticCast<Journal>(), &tzUsedList);
+                break;
+            default:
+                return;
+            }
+            allWritten = writeComponent(component);
+            ICalTimeZoneParser::updateTzEarliestDate(incidence, &earliestTz);
+        }
+    };
+
+    if (deleted) {
+        // only really deleted ones, not those which are back in the calendar
+        const Todo::List todos = cal->deletedTodos();
+        for (const Todo::Ptr &todo : todos) {
+            if (!cal->todo(todo->uid(), todo->recurrenceId())) {
+                writeIncidence(todo);
+            }
+        }
+        const Event::List events = cal->deletedEvents();
+        for (const Event::Ptr &event : events) {
+            if (!cal->event(event->uid(), event->recurrenceId())) {
+                writeIncidence(event);
+            }
+        }
+        const Journal::List journals = cal->deletedJournals();
+        for (const Journal::Ptr &journal : journals) {
+            if (!cal->journal(journal->uid(), journal->recurrenceId())) {
+                writeIncidence(journal);
+            }
+        }
+    } else {
+        for (auto type : { Incidence::TypeTodo, Incidence::TypeEvent, Incidence::TypeJournal }) {
+            cal->forEachIncidence(type, writeIncidence);
+        }
+    }
+    if (!allWritten) {
+        return false;
+    }
+
+    // time zones, once all the incidences using them are known
+    if (!hasIncidences) {
+        // no incidences means no used timezones, use all timezones
+        // this will export a calendar having only timezone definitions
+        tzUsedList = allTimeZones;
+    }
+    for (const auto &qtz : qAsConst(tzUsedList)) {
+        if (qtz != QTimeZone::utc()) {
+            icaltimezone *tz = ICalTimeZoneParser::icaltimezoneFromQTimeZone(qtz, earliestTz[qtz]);
+            if (!tz) {
+                qCritical() << "bad time zone";
+            } else {
+                const bool success = writeComponent(icalcomponent_new_clone(icaltimezone_get_component(tz)));
+                icaltimezone_free(tz, 1);
+                if (!success) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    const QByteArray footer("END:VCALENDAR\r\n");
+    return device->write(footer) == footer.size();
+}
 //@endcond
 
 ICalFormat::ICalFormat()
@@ -90,15 +208,24 @@ bool ICalFormat::load(const Calendar::Ptr &calendar, const QString &fileName)
         setException(new Exception(Exception::LoadError));
         return false;
     }
-    const QByteArray text = file.readAll().trimmed();
+
+    // Parse one incidence at a time, so that huge files never need to be
+    // held in memory as a whole.
+    const int threadCount = d->mLoadThreadCount > 0 ? d->mLoadThreadCount : QThread::idealThreadCount();
+    const bool success = d->mImpl->populate(calendar, &file, false, threadCount);
     file.close();
+    icalmemory_free_ring();
 
-    if (text.isEmpty()) {
-        // empty files are valid
-        return true;
-    } else {
-        return fromRawString(calendar, text, false, fileName);
+    if (!success) {
+        qCDebug(KCALCORE_LOG) << "Could not populate calendar";
+        if (!exception()) {
+            setException(new Exception(Exception::ParseErrorKcal));
+        }
+        return false;
     }
+
+    setLoadedProductId(d->mImpl->loadedProductId());
+    return true;
 }
 
 bool ICalFormat::save(const Calendar::Ptr &calendar, const QString &fileName)
@@ -107,11 +234,6 @@ bool ICalFormat::save(const Calendar::Ptr &calendar, const QString &fileName)
 
     clearException();
 
-    QString text = toString(calendar);
-    if (text.isEmpty()) {
-        return false;
-    }
-
     // Write backup file
     const QString backupFile = fileName + QLatin1Char('~');
     QFile::remove(backupFile);
@@ -126,9 +248,18 @@ bool ICalFormat::save(const Calendar::Ptr &calendar, const QString &fileName)
         return false;
     }
 
-    // Convert to UTF8 and save
-    QByteArray textUtf8 = text.toUtf8();
-    file.write(textUtf8.data(), textUtf8.size());
+    // Write UTF8 directly, one component at a time
+    const bool written = d->writeCalendar(calendar, &file, QString(), false, calendar->d->mTimeZones);
+    icalmemory_free_ring();
+
+    if (!written) {
+        qCDebug(KCALCORE_LOG) << "file write error:" << file.errorString();
+        file.cancelWriting();
+        setException(new Exception(Exception::SaveErrorSaveFile,
+                                   QStringList(fileName)));
+
+        return false;
+    }
 
     if (!file.commit()) {
         qCDebug(KCALCORE_LOG) << "file finalize error:" << file.errorString();
@@ -250,77 +381,12 @@ Incidence::Ptr ICalFormat::fromString(const QString &string)
 QString ICalFormat::toString(const Calendar::Ptr &cal,
                              const QString &notebook, bool deleted)
 {
-    icalcomponent *calendar = d->mImpl->createCalendarComponent(cal);
-    icalcomponent *component;
-
-    QVector<QTimeZone> tzUsedList;
-    TimeZoneEarliestDate earliestTz;
-
-    // todos
-    Todo::List todoList = deleted ? cal->deletedTodos() : cal->rawTodos();
-    for (auto it = todoList.cbegin(), end = todoList.cend(); it != end; ++it) {
-        if (!deleted || !cal->todo((*it)->uid(), (*it)->recurrenceId())) {
-            // use existing ones, or really deleted ones
-            if (notebook.isEmpty() ||
-                    (!cal->notebook(*it).isEmpty() && notebook.endsWith(cal->notebook(*it)))) {
-                component = d->mImpl->writeTodo(*it, &tzUsedList);
-                icalcomponent_add_component(calendar, component);
-                ICalTimeZoneParser::updateTzEarliestDate((*it), &earliestTz);
-            }
-        }
-    }
-    // events
-    Event::List events = deleted ? cal->deletedEvents() : cal->rawEvents();
-    for (auto it = events.cbegin(), end = events.cend(); it != end; ++it) {
-        if (!deleted || !cal->event((*it)->uid(), (*it)->recurrenceId())) {
-            // use existing ones, or really deleted ones
-            if (notebook.isEmpty() ||
-                    (!cal->notebook(*it).isEmpty() && notebook.endsWith(cal->notebook(*it)))) {
-                component = d->mImpl->writeEvent(*it, &tzUsedList);
-                icalcomponent_add_component(calendar, component);
-                ICalTimeZoneParser::updateTzEarliestDate((*it), &earliestTz);
-            }
-        }
-    }
-
-    // journals
-    Journal::List journals = deleted ? cal->deletedJournals() : cal->rawJournals();
-    for (auto it = journals.cbegin(), end = journals.cend(); it != end; ++it) {
-        if (!deleted || !cal->journal((*it)->uid(), (*it)->recurrenceId())) {
-            // use existing ones, or really deleted ones
-            if (notebook.isEmpty() ||
-                    (!cal->notebook(*it).isEmpty() && notebook.endsWith(cal->notebook(*it)))) {
-                component = d->mImpl->writeJournal(*it, &tzUsedList);
-                icalcomponent_add_component(calendar, component);
-                ICalTimeZoneParser::updateTzEarliestDate((*it), &earliestTz);
-            }
-        }
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    QString text;
+    if (d->writeCalendar(cal, &buffer, notebook, deleted, cal->d->mTimeZones)) {
+        text = QString::fromUtf8(buffer.data());
     }
-
-    // time zones
-    if (todoList.isEmpty() && events.isEmpty() && journals.isEmpty()) {
-        // no incidences means no used timezones, use all timezones
-        // this will export a calendar having only timezone definitions
-        tzUsedList = cal->d->mTimeZones;
-    }
-    for (const auto &qtz : qAsConst(tzUsedList)) {
-        if (qtz != QTimeZone::utc()) {
-            icaltimezone *tz = ICalTimeZoneParser::icaltimezoneFromQTimeZone(qtz, earliestTz[qtz]);
-            if (!tz) {
-                qCritical() << "bad time zone";
-            } else {
-                component = icalcomponent_new_clone(icaltimezone_get_component(tz));
-                icalcomponent_add_component(calendar, component);
-                icaltimezone_free(tz, 1);
-            }
-        }
-    }
-
-    char *const componentString = icalcomponent_as_ical_string_r(calendar);
-    const QString &text = QString::fromUtf8(componentString);
-    free(componentString);
-
-    icalcomponent_free(calendar);
     icalmemory_free_ring();
 
     if (text.isEmpty()) {
@@ -664,6 +730,16 @@ QByteArray ICalFormat::timeZoneId() const
     return d->mTimeZone.id();
 }
 
+void ICalFormat::setLoadThreadCount(int count)
+{
+    d->mLoadThreadCount = qMax(0, count);
+}
+
+int ICalFormat::loadThreadCount() const
+{
+    return d->mLoadThreadCount;
+}
+
 void ICalFormat::virtual_hook(int id, void *data)
 {
     Q_UNUSED(id);
@@ -70,6 +70,10 @@ public:
     /**
       @copydoc
       CalFormat::load()
+
+      Incidences which cannot be parsed are skipped. The others are still
+      loaded, but false is returned and the exception is set to
+      Exception::ParseErrorIcal.
     */
     bool load(const Calendar::Ptr &calendar, const QString &fileName) override;
 
@@ -224,6 +228,25 @@ public:
     */
     Q_REQUIRED_RESULT QByteArray timeZoneId() const;
 
+    /**
+      Sets the number of threads used to parse the incidences of a file in
+      load(). The incidences are still added to the calendar in file order,
+      from the calling thread.
+
+      @param count is the number of parsing threads. The default of 1 parses
+      on the calling thread only, 0 uses QThread::idealThreadCount().
+      @see loadThreadCount()
+      @since 5.64
+    */
+    void setLoadThreadCount(int count);
+
+    /**
+      Returns the number of threads used to parse incidences in load().
+      @see setLoadThreadCount()
+      @since 5.64
+    */
+    Q_REQUIRED_RESULT int loadThreadCount() const;
+
 protected:
     /**
       @copydoc
@@ -35,6 +35,7 @@
 */
 
 #include "icalformat_p.h"
+#include "calendar_p.h"
 #include "compat_p.h"
 #include "event.h"
 #include "freebusy.h"
@@ -48,7 +49,13 @@
 
 #include "kcalendarcore_debug.h"
 
+#include <QBuffer>
 #include <QFile>
+#include <QIODevice>
+#include <QMutex>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
 
 using namespace KCalendarCore;
 
@@ -159,12 +166,22 @@ public:
     void readIncidenceBase(icalcomponent *parent, const IncidenceBase::Ptr &);
     void writeCustomProperties(icalcomponent *parent, CustomProperties *);
     void readCustomProperties(icalcomponent *parent, CustomProperties *);
+    bool readCalendarProperties(const Calendar::Ptr &cal, icalcomponent *calendar);
+    void addTodo(const Calendar::Ptr &cal, const Todo::Ptr &todo, bool deleted);
+    void addEvent(const Calendar::Ptr &cal, const Event::Ptr &event, bool deleted);
+    void addJournal(const Calendar::Ptr &cal, const Journal::Ptr &journal, bool deleted);
+    void queueIncidence(const Incidence::Ptr &incidence);
+    void flushIncidences(const Calendar::Ptr &cal);
 
     ICalFormatImpl *mImpl = nullptr;
     ICalFormat *mParent = nullptr;
     QString mLoadedProductId;         // PRODID string loaded from calendar file
     Event::List mEventsRelate;        // events with relations
     Todo::List  mTodosRelate;         // todos with relations
+    QMutex mRelateLock;               // guards the above when parsing in parallel
+    Incidence::List mPendingIncidences; // new incidences, added to the calendar at once
+    QSet<QString> mPendingUids;       // UIDs of the above
+    bool mQueueIncidences = false;    // whether new incidences are queued at all
     Compat *mCompat = nullptr;
 };
 //@endcond
@@ -1199,7 +1216,10 @@ Todo::Ptr ICalFormatImpl::readTodo(icalcomponent *vtodo, const ICalTimeZoneCache
 
         case ICAL_RELATEDTO_PROPERTY:  // related todo (parent)
             todo->setRelatedTo(QString::fromUtf8(icalproperty_get_relatedto(p)));
-            d->mTodosRelate.append(todo);
+            {
+                QMutexLocker locker(&d->mRelateLock);
+                d->mTodosRelate.append(todo);
+            }
             break;
 
         case ICAL_DTSTART_PROPERTY:
@@ -1273,7 +1293,10 @@ Event::Ptr ICalFormatImpl::readEvent(icalcomponent *vevent, const ICalTimeZoneCa
         }
         case ICAL_RELATEDTO_PROPERTY:  // related event (parent)
             event->setRelatedTo(QString::fromUtf8(icalproperty_get_relatedto(p)));
-            d->mEventsRelate.append(event);
+            {
+                QMutexLocker locker(&d->mRelateLock);
+                d->mEventsRelate.append(event);
+            }
             break;
 
         case ICAL_TRANSP_PROPERTY: { // Transparency
@@ -2487,9 +2510,9 @@ QDateTime ICalFormatImpl::readICalDateTime(icalproperty *p, const icaltimetype &
         // A workaround for a bug in libical (https://github.com/libical/libical/issues/185)
         // If a recurrenceId has both tzid and range, both parameters end up in the tzid.
         // This results in invalid tzid's like: "Europe/Berlin;RANGE=THISANDFUTURE"
-        QStringList parts = QString::fromLatin1(tzid).split(QLatin1Char(';'));
-        if (parts.count() > 1) {
-            tzid = parts.first().toLatin1();
+        const int separator = tzid.indexOf(';');
+        if (separator >= 0) {
+            tzid.truncate(separator);
         }
 
         if (tzCache) {
@@ -2744,6 +2767,346 @@ bool ICalFormatImpl::populate(const Calendar::Ptr &cal, icalcomponent *calendar,
         return false;
     }
 
+    if (!d->readCalendarProperties(cal, calendar)) {
+        return false;
+    }
+
+    // Only calendars which insert them directly get the incidences at once,
+    // the others may do more in addEvent() and the like
+    d->mQueueIncidences = bool(cal->d->mInsertIncidences);
+
+    // Populate the calendar's time zone collection with all VTIMEZONE components
+    ICalTimeZoneCache timeZoneCache;
+    ICalTimeZoneParser parser(&timeZoneCache);
+    parser.parse(calendar);
+
+    // Store all events with a relatedTo property in a list for post-processing
+    d->mEventsRelate.clear();
+    d->mTodosRelate.clear();
+    // TODO: make sure that only actually added events go to this lists.
+
+    icalcomponent *c = icalcomponent_get_first_component(calendar, ICAL_VTODO_COMPONENT);
+    while (c) {
+        d->addTodo(cal, readTodo(c, &timeZoneCache), deleted);
+        c = icalcomponent_get_next_component(calendar, ICAL_VTODO_COMPONENT);
+    }
+
+    // Iterate through all events
+    c = icalcomponent_get_first_component(calendar, ICAL_VEVENT_COMPONENT);
+    while (c) {
+        d->addEvent(cal, readEvent(c, &timeZoneCache), deleted);
+        c = icalcomponent_get_next_component(calendar, ICAL_VEVENT_COMPONENT);
+    }
+
+    // Iterate through all journals
+    c = icalcomponent_get_first_component(calendar, ICAL_VJOURNAL_COMPONENT);
+    while (c) {
+        d->addJournal(cal, readJournal(c, &timeZoneCache), deleted);
+        c = icalcomponent_get_next_component(calendar, ICAL_VJOURNAL_COMPONENT);
+    }
+    d->flushIncidences(cal);
+
+    // TODO: Remove any previous time zones no longer referenced in the calendar
+
+    return true;
+}
+
+//@cond PRIVATE
+// Returns the upper-cased component name of a "BEGIN:" or "END:" line,
+// or an empty array if @p line is not such a line.
+static QByteArray componentBoundary(const QByteArray &line, const char *keyword)
+{
+    const int length = qstrlen(keyword);
+    if (line.size() <= length || qstrnicmp(line.constData(), keyword, length) != 0) {
+        return QByteArray();
+    }
+    return line.mid(length).trimmed().toUpper();
+}
+
+static bool readContentLine(QIODevice *device, QByteArray &line)
+{
+    if (device->atEnd()) {
+        return false;
+    }
+    const bool atStart = device->pos() == 0;
+    line = device->readLine();
+    if (atStart && line.startsWith("\xEF\xBB\xBF")) {
+        line.remove(0, 3);  // UTF-8 byte order mark
+    }
+    return !line.isEmpty();
+}
+
+// Parses a range of component slices on a worker thread. The time zone
+// cache is only read, and every result goes to its own slot.
+class ComponentParser : public QRunnable
+{
+public:
+    ComponentParser(ICalFormatImpl *impl, const ICalTimeZoneCache *tzList,
+                    const QByteArray *components, Incidence::Ptr *incidences, int count)
+        : mImpl(impl), mTzList(tzList), mComponents(components), mIncidences(incidences), mCount(count)
+    {
+    }
+
+    void run() override
+    {
+        for (int i = 0; i < mCount; ++i) {
+            mIncidences[i] = mImpl->readIncidenceComponent(mComponents[i], mTzList);
+        }
+        icalmemory_free_ring();
+    }
+
+private:
+    ICalFormatImpl *mImpl = nullptr;
+    const ICalTimeZoneCache *mTzList = nullptr;
+    const QByteArray *mComponents = nullptr;
+    Incidence::Ptr *mIncidences = nullptr;
+    int mCount = 0;
+};
+//@endcond
+
+// Same as populate() above, but reads the raw vcalendar incrementally: only
+// one incidence (or one batch of them, when parsing in parallel) is parsed
+// into a libical tree at any time, which keeps the memory used by very large
+// files bounded by their largest components.
+bool ICalFormatImpl::populate(const Calendar::Ptr &cal, QIODevice *device, bool deleted, int threadCount)
+{
+    if (!device || !device->isReadable()) {
+        qCWarning(KCALCORE_LOG) << "Populate called with an unusable device";
+        return false;
+    }
+
+    if (device->isSequential()) {
+        // Pipes and the like cannot be read twice, so buffer them first
+        QByteArray data = device->readAll();
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::ReadOnly);
+        return populate(cal, &buffer, deleted, threadCount);
+    }
+
+    // First pass: collect the properties and the VTIMEZONE components of each
+    // VCALENDAR, as incidences may refer to time zones defined after them.
+    QVector<QByteArray> headers;
+    bool hasContent = false;
+    {
+        QByteArray line;
+        QByteArray header;
+        int depth = 0;
+        bool inCalendar = false;
+        bool inTimeZone = false;
+        while (readContentLine(device, line)) {
+            if (line.trimmed().isEmpty()) {
+                continue;
+            }
+            hasContent = true;
+
+            const QByteArray begin = componentBoundary(line, "BEGIN:");
+            const QByteArray end = begin.isEmpty() ? componentBoundary(line, "END:") : QByteArray();
+            if (!begin.isEmpty()) {
+                if (depth == 0) {
+                    inCalendar = begin == "VCALENDAR";
+                    header.clear();
+                } else if (depth == 1) {
+                    inTimeZone = inCalendar && begin == "VTIMEZONE";
+                }
+                ++depth;
+            }
+            if (inCalendar && (depth == 1 || inTimeZone)) {
+                header += line;
+            }
+            if (!end.isEmpty() && depth > 0) {
+                if (--depth == 1) {
+                    inTimeZone = false;
+                } else if (depth == 0 && inCalendar) {
+                    headers.append(header);
+                    header.clear();
+                    inCalendar = false;
+                }
+            }
+        }
+    }
+
+    if (!hasContent) {
+        // empty files are valid
+        return true;
+    }
+    if (headers.isEmpty()) {
+        qCDebug(KCALCORE_LOG) << "No VCALENDAR component found";
+        d->mParent->setException(new Exception(Exception::NoCalendar));
+        return false;
+    }
+
+    // Second pass: parse and insert the incidences one by one.
+    d->mQueueIncidences = bool(cal->d->mInsertIncidences);
+    if (!device->seek(0)) {
+        qCWarning(KCALCORE_LOG) << "Could not rewind device" << device->errorString();
+        d->mParent->setException(new Exception(Exception::LoadError));
+        return false;
+    }
+
+    bool success = true;
+    ICalTimeZoneCache timeZoneCache;
+
+    // Incidences are parsed in batches, by several threads if requested, but
+    // always added to the calendar by this thread. Like above, the to-dos of
+    // each VCALENDAR come first, then the events, then the journals.
+    QScopedPointer<QThreadPool> threadPool;
+    if (threadCount > 1) {
+        threadPool.reset(new QThreadPool);
+        threadPool->setMaxThreadCount(threadCount);
+    }
+    const int batchSize = threadCount > 1 ? 64 * threadCount : 1;
+    QVector<QByteArray> batch;
+    batch.reserve(batchSize);
+    Todo::List todos;
+    Event::List events;
+    Journal::List journals;
+    const auto flushBatch = [&]() {
+        QVector<Incidence::Ptr> incidences(batch.size());
+        if (threadPool && batch.size() > 1) {
+            const int chunkSize = (batch.size() + threadCount - 1) / threadCount;
+            for (int first = 0; first < batch.size(); first += chunkSize) {
+                const int count = qMin(chunkSize, batch.size() - first);
+                threadPool->start(new ComponentParser(this, &timeZoneCache, batch.constData() + first,
+                                                      incidences.data() + first, count));
+            }
+            threadPool->waitForDone();
+        } else {
+            for (int i = 0; i < batch.size(); ++i) {
+                incidences[i] = readIncidenceComponent(batch.at(i), &timeZoneCache);
+            }
+        }
+        batch.clear();
+
+        for (const Incidence::Ptr &incidence : qAsConst(incidences)) {
+            if (!incidence) {
+                // Do not let the data loss go unnoticed
+                if (!d->mParent->exception()) {
+                    d->mParent->setException(new Exception(Exception::ParseErrorIcal));
+                }
+                success = false;
+                continue;
+            }
+            switch (incidence->type()) {
+            case IncidenceBase::TypeTodo:
+                todos.append(incidence.staticCast<Todo>());
+                break;
+            case IncidenceBase::TypeEvent:
+                events.append(incidence.staticCast<Event>());
+                break;
+            case IncidenceBase::TypeJournal:
+                journals.append(incidence.staticCast<Journal>());
+                break;
+            default:
+                break;
+            }
+        }
+    };
+    const auto addIncidences = [&]() {
+        flushBatch();
+        for (const Todo::Ptr &todo : qAsConst(todos)) {
+            d->addTodo(cal, todo, deleted);
+        }
+        for (const Event::Ptr &event : qAsConst(events)) {
+            d->addEvent(cal, event, deleted);
+        }
+        for (const Journal::Ptr &journal : qAsConst(journals)) {
+            d->addJournal(cal, journal, deleted);
+        }
+        todos.clear();
+        events.clear();
+        journals.clear();
+    };
+
+    QByteArray line;
+    QByteArray component;
+    int calendarIndex = -1;
+    int depth = 0;
+    bool calendarValid = false;
+    bool inIncidence = false;
+    while (readContentLine(device, line)) {
+        const QByteArray begin = componentBoundary(line, "BEGIN:");
+        if (!begin.isEmpty()) {
+            if (depth == 0 && begin == "VCALENDAR" && ++calendarIndex < headers.size()) {
+                // The time zones of the previous calendar are about to go away
+                addIncidences();
+
+                icalcomponent *calendar = icalcomponent_new_from_string(headers.at(calendarIndex).constData());
+                if (!calendar || icalcomponent_isa(calendar) != ICAL_VCALENDAR_COMPONENT) {
+                    qCWarning(KCALCORE_LOG) << "Could not parse VCALENDAR properties";
+                    d->mParent->setException(new Exception(Exception::ParseErrorIcal));
+                    calendarValid = false;
+                } else {
+                    timeZoneCache.clear();
+                    ICalTimeZoneParser parser(&timeZoneCache);
+                    parser.parse(calendar);
+                    d->mEventsRelate.clear();
+                    d->mTodosRelate.clear();
+                    calendarValid = d->readCalendarProperties(cal, calendar);
+                }
+                if (calendar) {
+                    icalcomponent_free(calendar);
+                }
+                success = success && calendarValid;
+            } else if (depth == 1 && calendarValid
+                       && (begin == "VTODO" || begin == "VEVENT" || begin == "VJOURNAL")) {
+                inIncidence = true;
+                component.clear();
+            }
+            ++depth;
+        } else if (depth > 0 && !componentBoundary(line, "END:").isEmpty()) {
+            --depth;
+            if (depth == 1 && inIncidence) {
+                component += line;
+                inIncidence = false;
+
+                batch.append(component);
+                if (batch.size() >= batchSize) {
+                    flushBatch();
+                }
+                continue;
+            }
+        }
+
+        if (inIncidence) {
+            component += line;
+        }
+    }
+    addIncidences();
+    d->flushIncidences(cal);
+
+    return success;
+}
+
+Incidence::Ptr ICalFormatImpl::readIncidenceComponent(const QByteArray &data, const ICalTimeZoneCache *tzList)
+{
+    icalcomponent *c = icalcomponent_new_from_string(data.constData());
+    if (!c) {
+        qCWarning(KCALCORE_LOG) << "Skipping unparsable component";
+        return Incidence::Ptr();
+    }
+
+    Incidence::Ptr incidence;
+    switch (icalcomponent_isa(c)) {
+    case ICAL_VTODO_COMPONENT:
+        incidence = readTodo(c, tzList);
+        break;
+    case ICAL_VEVENT_COMPONENT:
+        incidence = readEvent(c, tzList);
+        break;
+    case ICAL_VJOURNAL_COMPONENT:
+        incidence = readJournal(c, tzList);
+        break;
+    default:
+        break;
+    }
+    icalcomponent_free(c);
+
+    return incidence;
+}
+
+//@cond PRIVATE
+bool ICalFormatImpl::Private::readCalendarProperties(const Calendar::Ptr &cal, icalcomponent *calendar)
+{
 // TODO: check for METHOD
 
     icalproperty *p = icalcomponent_get_first_property(calendar, ICAL_X_PROPERTY);
@@ -2770,160 +3133,172 @@ bool ICalFormatImpl::populate(const Calendar::Ptr &cal, icalcomponent *calendar,
     p = icalcomponent_get_first_property(calendar, ICAL_PRODID_PROPERTY);
     if (!p) {
         qCDebug(KCALCORE_LOG) << "No PRODID property found";
-        d->mLoadedProductId.clear();
+        mLoadedProductId.clear();
     } else {
-        d->mLoadedProductId = QString::fromUtf8(icalproperty_get_prodid(p));
+        mLoadedProductId = QString::fromUtf8(icalproperty_get_prodid(p));
 
-        delete d->mCompat;
-        d->mCompat = CompatFactory::createCompat(d->mLoadedProductId, implementationVersion);
+        delete mCompat;
+        mCompat = CompatFactory::createCompat(mLoadedProductId, implementationVersion);
     }
 
     p = icalcomponent_get_first_property(calendar, ICAL_VERSION_PROPERTY);
     if (!p) {
         qCDebug(KCALCORE_LOG) << "No VERSION property found";
-        d->mParent->setException(new Exception(Exception::CalVersionUnknown));
+        mParent->setException(new Exception(Exception::CalVersionUnknown));
         return false;
     } else {
         const char *version = icalproperty_get_version(p);
         if (!version) {
             qCDebug(KCALCORE_LOG) << "No VERSION property found";
-            d->mParent->setException(new Exception(Exception::VersionPropertyMissing));
+            mParent->setException(new Exception(Exception::VersionPropertyMissing));
 
             return false;
         }
         if (strcmp(version, "1.0") == 0) {
             qCDebug(KCALCORE_LOG) << "Expected iCalendar, got vCalendar";
-            d->mParent->setException(new Exception(Exception::CalVersion1));
+            mParent->setException(new Exception(Exception::CalVersion1));
             return false;
         } else if (strcmp(version, "2.0") != 0) {
             qCDebug(KCALCORE_LOG) << "Expected iCalendar, got unknown format";
-            d->mParent->setException(new Exception(
-                                         Exception::CalVersionUnknown));
+            mParent->setException(new Exception(
+                                      Exception::CalVersionUnknown));
             return false;
         }
     }
 
-    // Populate the calendar's time zone collection with all VTIMEZONE components
-    ICalTimeZoneCache timeZoneCache;
-    ICalTimeZoneParser parser(&timeZoneCache);
-    parser.parse(calendar);
-
     // custom properties
-    d->readCustomProperties(calendar, cal.data());
+    readCustomProperties(calendar, cal.data());
 
-    // Store all events with a relatedTo property in a list for post-processing
-    d->mEventsRelate.clear();
-    d->mTodosRelate.clear();
-    // TODO: make sure that only actually added events go to this lists.
+    return true;
+}
 
-    icalcomponent *c = icalcomponent_get_first_component(calendar, ICAL_VTODO_COMPONENT);
-    while (c) {
-        Todo::Ptr todo = readTodo(c, &timeZoneCache);
-        if (todo) {
-            // qCDebug(KCALCORE_LOG) << "todo is not zero and deleted is " << deleted;
-            Todo::Ptr old = cal->todo(todo->uid(), todo->recurrenceId());
-            if (old) {
-                if (old->uid().isEmpty()) {
-                    qCWarning(KCALCORE_LOG) << "Skipping invalid VTODO";
-                    c = icalcomponent_get_next_component(calendar, ICAL_VTODO_COMPONENT);
-                    continue;
-                }
-                // qCDebug(KCALCORE_LOG) << "Found an old todo with uid " << old->uid();
-                if (deleted) {
-                    // qCDebug(KCALCORE_LOG) << "Todo " << todo->uid() << " already deleted";
-                    cal->deleteTodo(old);   // move old to deleted
-                    removeAllICal(d->mTodosRelate, old);
-                } else if (todo->revision() > old->revision()) {
-                    // qCDebug(KCALCORE_LOG) << "Replacing old todo " << old.data() << " with this one " << todo.data();
-                    cal->deleteTodo(old);   // move old to deleted
-                    removeAllICal(d->mTodosRelate, old);
-                    cal->addTodo(todo);   // and replace it with this one
-                }
-            } else if (deleted) {
-                // qCDebug(KCALCORE_LOG) << "Todo " << todo->uid() << " already deleted";
-                old = cal->deletedTodo(todo->uid(), todo->recurrenceId());
-                if (!old) {
-                    cal->addTodo(todo);   // add this one
-                    cal->deleteTodo(todo);   // and move it to deleted
-                }
-            } else {
-                // qCDebug(KCALCORE_LOG) << "Adding todo " << todo.data() << todo->uid();
-                cal->addTodo(todo);   // just add this one
-            }
-        }
-        c = icalcomponent_get_next_component(calendar, ICAL_VTODO_COMPONENT);
+void ICalFormatImpl::Private::addTodo(const Calendar::Ptr &cal, const Todo::Ptr &todo, bool deleted)
+{
+    if (!todo) {
+        return;
     }
+    if (mPendingUids.contains(todo->uid())) {
+        flushIncidences(cal);   // the lookups below must see the earlier ones
+    }
+    // qCDebug(KCALCORE_LOG) << "todo is not zero and deleted is " << deleted;
+    Todo::Ptr old = cal->todo(todo->uid(), todo->recurrenceId());
+    if (old) {
+        if (old->uid().isEmpty()) {
+            qCWarning(KCALCORE_LOG) << "Skipping invalid VTODO";
+            return;
+        }
+        // qCDebug(KCALCORE_LOG) << "Found an old todo with uid " << old->uid();
+        if (deleted) {
+            // qCDebug(KCALCORE_LOG) << "Todo " << todo->uid() << " already deleted";
+            cal->deleteTodo(old);   // move old to deleted
+            removeAllICal(mTodosRelate, old);
+        } else if (todo->revision() > old->revision()) {
+            // qCDebug(KCALCORE_LOG) << "Replacing old todo " << old.data() << " with this one " << todo.data();
+            cal->deleteTodo(old);   // move old to deleted
+            removeAllICal(mTodosRelate, old);
+            cal->addTodo(todo);   // and replace it with this one
+        }
+    } else if (deleted) {
+        // qCDebug(KCALCORE_LOG) << "Todo " << todo->uid() << " already deleted";
+        old = cal->deletedTodo(todo->uid(), todo->recurrenceId());
+        if (!old) {
+            cal->addTodo(todo);   // add this one
+            cal->deleteTodo(todo);   // and move it to deleted
+        }
+    } else if (mQueueIncidences) {
+        queueIncidence(todo);   // just add this one, along with the others
+    } else {
+        // qCDebug(KCALCORE_LOG) << "Adding todo " << todo.data() << todo->uid();
+        cal->addTodo(todo);   // just add this one
+    }
+}
 
-    // Iterate through all events
-    c = icalcomponent_get_first_component(calendar, ICAL_VEVENT_COMPONENT);
-    while (c) {
-        Event::Ptr event = readEvent(c, &timeZoneCache);
-        if (event) {
-            // qCDebug(KCALCORE_LOG) << "event is not zero and deleted is " << deleted;
-            Event::Ptr old = cal->event(event->uid(), event->recurrenceId());
-            if (old) {
-                if (old->uid().isEmpty()) {
-                    qCWarning(KCALCORE_LOG) << "Skipping invalid VEVENT";
-                    c = icalcomponent_get_next_component(calendar, ICAL_VEVENT_COMPONENT);
-                    continue;
-                }
-                // qCDebug(KCALCORE_LOG) << "Found an old event with uid " << old->uid();
-                if (deleted) {
-                    // qCDebug(KCALCORE_LOG) << "Event " << event->uid() << " already deleted";
-                    cal->deleteEvent(old);   // move old to deleted
-                    removeAllICal(d->mEventsRelate, old);
-                } else if (event->revision() > old->revision()) {
-                    // qCDebug(KCALCORE_LOG) << "Replacing old event " << old.data()
-                    //                       << " with this one " << event.data();
-                    cal->deleteEvent(old);   // move old to deleted
-                    removeAllICal(d->mEventsRelate, old);
-                    cal->addEvent(event);   // and replace it with this one
-                }
-            } else if (deleted) {
-                // qCDebug(KCALCORE_LOG) << "Event " << event->uid() << " already deleted";
-                old = cal->deletedEvent(event->uid(), event->recurrenceId());
-                if (!old) {
-                    cal->addEvent(event);   // add this one
-                    cal->deleteEvent(event);   // and move it to deleted
-                }
-            } else {
-                // qCDebug(KCALCORE_LOG) << "Adding event " << event.data() << event->uid();
-                cal->addEvent(event);   // just add this one
-            }
-        }
-        c = icalcomponent_get_next_component(calendar, ICAL_VEVENT_COMPONENT);
+void ICalFormatImpl::Private::addEvent(const Calendar::Ptr &cal, const Event::Ptr &event, bool deleted)
+{
+    if (!event) {
+        return;
     }
+    if (mPendingUids.contains(event->uid())) {
+        flushIncidences(cal);   // the lookups below must see the earlier ones
+    }
+    // qCDebug(KCALCORE_LOG) << "event is not zero and deleted is " << deleted;
+    Event::Ptr old = cal->event(event->uid(), event->recurrenceId());
+    if (old) {
+        if (old->uid().isEmpty()) {
+            qCWarning(KCALCORE_LOG) << "Skipping invalid VEVENT";
+            return;
+        }
+        // qCDebug(KCALCORE_LOG) << "Found an old event with uid " << old->uid();
+        if (deleted) {
+            // qCDebug(KCALCORE_LOG) << "Event " << event->uid() << " already deleted";
+            cal->deleteEvent(old);   // move old to deleted
+            removeAllICal(mEventsRelate, old);
+        } else if (event->revision() > old->revision()) {
+            // qCDebug(KCALCORE_LOG) << "Replacing old event " << old.data()
+            //                       << " with this one " << event.data();
+            cal->deleteEvent(old);   // move old to deleted
+            removeAllICal(mEventsRelate, old);
+            cal->addEvent(event);   // and replace it with this one
+        }
+    } else if (deleted) {
+        // qCDebug(KCALCORE_LOG) << "Event " << event->uid() << " already deleted";
+        old = cal->deletedEvent(event->uid(), event->recurrenceId());
+        if (!old) {
+            cal->addEvent(event);   // add this one
+            cal->deleteEvent(event);   // and move it to deleted
+        }
+    } else if (mQueueIncidences) {
+        queueIncidence(event);   // just add this one, along with the others
+    } else {
+        // qCDebug(KCALCORE_LOG) << "Adding event " << event.data() << event->uid();
+        cal->addEvent(event);   // just add this one
+    }
+}
 
-    // Iterate through all journals
-    c = icalcomponent_get_first_component(calendar, ICAL_VJOURNAL_COMPONENT);
-    while (c) {
-        Journal::Ptr journal = readJournal(c, &timeZoneCache);
-        if (journal) {
-            Journal::Ptr old = cal->journal(journal->uid(), journal->recurrenceId());
-            if (old) {
-                if (deleted) {
-                    cal->deleteJournal(old);   // move old to deleted
-                } else if (journal->revision() > old->revision()) {
-                    cal->deleteJournal(old);   // move old to deleted
-                    cal->addJournal(journal);   // and replace it with this one
-                }
-            } else if (deleted) {
-                old = cal->deletedJournal(journal->uid(), journal->recurrenceId());
-                if (!old) {
-                    cal->addJournal(journal);   // add this one
-                    cal->deleteJournal(journal);   // and move it to deleted
-                }
-            } else {
-                cal->addJournal(journal);   // just add this one
-            }
-        }
-        c = icalcomponent_get_next_component(calendar, ICAL_VJOURNAL_COMPONENT);
+void ICalFormatImpl::Private::addJournal(const Calendar::Ptr &cal, const Journal::Ptr &journal, bool deleted)
+{
+    if (!journal) {
+        return;
+    }
+    if (mPendingUids.contains(journal->uid())) {
+        flushIncidences(cal);   // the lookups below must see the earlier ones
+    }
+    Journal::Ptr old = cal->journal(journal->uid(), journal->recurrenceId());
+    if (old) {
+        if (deleted) {
+            cal->deleteJournal(old);   // move old to deleted
+        } else if (journal->revision() > old->revision()) {
+            cal->deleteJournal(old);   // move old to deleted
+            cal->addJournal(journal);   // and replace it with this one
+        }
+    } else if (deleted) {
+        old = cal->deletedJournal(journal->uid(), journal->recurrenceId());
+        if (!old) {
+            cal->addJournal(journal);   // add this one
+            cal->deleteJournal(journal);   // and move it to deleted
+        }
+    } else if (mQueueIncidences) {
+        queueIncidence(journal);   // just add this one, along with the others
+    } else {
+        cal->addJournal(journal);   // just add this one
     }
+}
 
-    // TODO: Remove any previous time zones no longer referenced in the calendar
+void ICalFormatImpl::Private::queueIncidence(const Incidence::Ptr &incidence)
+{
+    mPendingIncidences.append(incidence);
+    mPendingUids.insert(incidence->uid());
+}
 
-    return true;
+void ICalFormatImpl::Private::flushIncidences(const Calendar::Ptr &cal)
+{
+    if (!mPendingIncidences.isEmpty()) {
+        cal->addIncidences(mPendingIncidences);
+        mPendingIncidences.clear();
+        mPendingUids.clear();
+    }
 }
+//@endcond
 
 QString ICalFormatImpl::extractErrorProperty(icalcomponent *c)
 {
@@ -45,6 +45,7 @@
 #include <libical/ical.h>
 
 class QDate;
+class QIODevice;
 
 namespace KCalendarCore
 {
@@ -109,8 +110,27 @@ public:
     bool populate(const Calendar::Ptr &calendar, icalcomponent *fs,
                   bool deleted = false, const QString &notebook = QString());
 
+    /**
+      Updates a calendar with the raw iCalendar data read from @p device, like
+      populate() does, but without ever holding more than one incidence in
+      memory as a libical component. The device must be open for reading.
+      As it is read twice, a sequential device is read into memory first.
+
+      With a @p threadCount above 1, incidences are parsed by that many
+      threads, in batches, and still added to @p calendar in file order.
+    */
+    bool populate(const Calendar::Ptr &calendar, QIODevice *device, bool deleted = false,
+                  int threadCount = 1);
+
     Incidence::Ptr readOneIncidence(icalcomponent *calendar, const ICalTimeZoneCache *tzlist);
 
+    /**
+      Parses a single VEVENT, VTODO or VJOURNAL component from its raw text.
+      Safe to call from several threads at once, as long as @p tzList is
+      not modified meanwhile.
+    */
+    Incidence::Ptr readIncidenceComponent(const QByteArray &data, const ICalTimeZoneCache *tzList);
+
     icalcomponent *writeIncidence(const IncidenceBase::Ptr &incidence,
                                   iTIPMethod method = iTIPRequest,
                                   TimeZoneList *tzUsedList = nullptr);
@@ -30,6 +30,10 @@
 
 #include <QDateTime>
 #include <QByteArray>
+#include <QDataStream>
+#include <QMutex>
+
+#include <limits>
 
 extern "C" {
 #include <libical/ical.h>
@@ -114,59 +118,129 @@ ICalTimeZoneCache::ICalTimeZoneCache()
 void ICalTimeZoneCache::insert(const QByteArray &id, const ICalTimeZone &tz)
 {
     mCache.insert(id, tz);
+    QWriteLocker locker(&mResolvedLock);
+    mResolved.remove(id);
+}
+
+void ICalTimeZoneCache::clear()
+{
+    mCache.clear();
+    QWriteLocker locker(&mResolvedLock);
+    mResolved.clear();
 }
 
 namespace {
 
-template<typename T>
-typename T::const_iterator greatestSmallerThan(const T &c, const typename T::value_type &v)
+// Time zones matched to VTIMEZONE definitions, shared by all parsers in the
+// process. Calendars from the same source tend to carry the same non-IANA
+// definitions over and over, and matching one against the system time zones
+// is expensive.
+struct MatchedTimeZones {
+    QMutex lock;
+    QHash<QByteArray, QTimeZone> zones;
+};
+Q_GLOBAL_STATIC(MatchedTimeZones, matchedTimeZones)
+
+// Identify a VTIMEZONE definition by its offsets, abbreviations and
+// transitions, regardless of its TZID.
+QByteArray timeZoneFingerprint(const ICalTimeZone &icalZone)
 {
-    auto it = std::lower_bound(c.cbegin(), c.cend(), v);
-    if (it != c.cbegin()) {
-        return --it;
+    QByteArray fingerprint;
+    QDataStream stream(&fingerprint, QIODevice::WriteOnly);
+    for (const ICalTimeZonePhase *phase : {&icalZone.standard, &icalZone.daylight}) {
+        QList<QByteArray> abbrevs = phase->abbrevs.values();
+        std::sort(abbrevs.begin(), abbrevs.end());
+        stream << qint32(phase->utcOffset) << abbrevs << qint32(phase->transitions.count());
+        for (const QDateTime &transition : phase->transitions) {
+            stream << transition.toMSecsSinceEpoch();
+        }
     }
-    return c.cend();
+    return fingerprint;
 }
 
 }
 
 QTimeZone ICalTimeZoneCache::tzForTime(const QDateTime &dt, const QByteArray &tzid) const
 {
-    if (QTimeZone::isTimeZoneIdAvailable(tzid)) {
-        return QTimeZone(tzid);
+    ResolvedTimeZone resolved;
+    bool found;
+    {
+        QReadLocker locker(&mResolvedLock);
+        const auto it = mResolved.constFind(tzid);
+        found = (it != mResolved.constEnd());
+        if (found) {
+            resolved = it.value();
+        }
+    }
+    if (!found) {
+        resolved = resolve(tzid);
+        QWriteLocker locker(&mResolvedLock);
+        mResolved.insert(tzid, resolved);
     }
 
-    const ICalTimeZone tz = mCache.value(tzid);
-    if (!tz.qZone.isValid()) {
-        return QTimeZone::systemTimeZone();
+    if (!resolved.daylightZone.isValid()) {
+        return resolved.zone;
     }
 
     // If the matched timezone is one of the UTC offset timezones, we need to make
     // sure it's in the correct DTS.
     // The lookup in ICalTimeZoneParser will only find TZ in standard time, but
     // if the datetim in question fits in the DTS zone, we need to use another UTC
-    // offset timezone
-    if (tz.qZone.id().startsWith("UTC")) { //krazy:exclude=strings
-        // Find the nearest standard and DST transitions that occur BEFORE the "dt"
-        const auto stdPrev = greatestSmallerThan(tz.standard.transitions, dt);
-        const auto dstPrev = greatestSmallerThan(tz.daylight.transitions, dt);
-        if (stdPrev != tz.standard.transitions.cend() && dstPrev != tz.daylight.transitions.cend()) {
-            if (*dstPrev > *stdPrev) {
-                // Previous DTS is closer to "dt" than previous standard, which
-                // means we are in DTS right now
-                const auto tzids = QTimeZone::availableTimeZoneIds(tz.daylight.utcOffset);
-                auto dtsTzId = std::find_if(tzids.cbegin(), tzids.cend(),
-                                            [](const QByteArray &id) {
-                                                return id.startsWith("UTC"); //krazy:exclude=strings
-                                            });
-                if (dtsTzId != tzids.cend()) {
-                    return QTimeZone(*dtsTzId);
-                }
+    // offset timezone.
+    // Find the nearest transition that occurs BEFORE the "dt". If it is a DST one,
+    // and there was a standard one before, we are in DTS right now.
+    const qint64 msecs = dt.toMSecsSinceEpoch();
+    auto it = std::lower_bound(resolved.transitions.cbegin(), resolved.transitions.cend(), msecs,
+                               [](const ResolvedTimeZone::Transition &transition, qint64 msecs) {
+                                   return transition.utcMSecs < msecs;
+                               });
+    if (it != resolved.transitions.cbegin() && (--it)->daylight && resolved.firstStandard < msecs) {
+        return resolved.daylightZone;
+    }
+    return resolved.zone;
+}
+
+ICalTimeZoneCache::ResolvedTimeZone ICalTimeZoneCache::resolve(const QByteArray &tzid) const
+{
+    ResolvedTimeZone resolved;
+    resolved.firstStandard = std::numeric_limits<qint64>::max();
+    if (QTimeZone::isTimeZoneIdAvailable(tzid)) {
+        resolved.zone = QTimeZone(tzid);
+        return resolved;
+    }
+
+    const ICalTimeZone tz = mCache.value(tzid);
+    if (!tz.qZone.isValid()) {
+        resolved.zone = QTimeZone::systemTimeZone();
+        return resolved;
+    }
+    resolved.zone = tz.qZone;
+
+    if (tz.qZone.id().startsWith("UTC") && //krazy:exclude=strings
+            !tz.standard.transitions.isEmpty() && !tz.daylight.transitions.isEmpty()) {
+        const auto tzids = QTimeZone::availableTimeZoneIds(tz.daylight.utcOffset);
+        auto dtsTzId = std::find_if(tzids.cbegin(), tzids.cend(),
+                                    [](const QByteArray &id) {
+                                        return id.startsWith("UTC"); //krazy:exclude=strings
+                                    });
+        if (dtsTzId != tzids.cend()) {
+            resolved.daylightZone = QTimeZone(*dtsTzId);
+            for (const QDateTime &transition : tz.standard.transitions) {
+                resolved.transitions.append({transition.toMSecsSinceEpoch(), false});
+            }
+            for (const QDateTime &transition : tz.daylight.transitions) {
+                resolved.transitions.append({transition.toMSecsSinceEpoch(), true});
             }
+            // On a tie, standard time wins
+            std::sort(resolved.transitions.begin(), resolved.transitions.end(),
+                      [](const ResolvedTimeZone::Transition &a, const ResolvedTimeZone::Transition &b) {
+                          return a.utcMSecs < b.utcMSecs || (a.utcMSecs == b.utcMSecs && a.daylight && !b.daylight);
+                      });
+            resolved.firstStandard = std::min_element(tz.standard.transitions.cbegin(),
+                                                      tz.standard.transitions.cend())->toMSecsSinceEpoch();
         }
     }
-
-    return tz.qZone;
+    return resolved;
 }
 
 ICalTimeZoneParser::ICalTimeZoneParser(ICalTimeZoneCache *cache)
@@ -464,6 +538,24 @@ void ICalTimeZoneParser::parse(icalcomponent *calendar)
 }
 
 QTimeZone ICalTimeZoneParser::resolveICalTimeZone(const ICalTimeZone &icalZone)
+{
+    const QByteArray fingerprint = timeZoneFingerprint(icalZone);
+    MatchedTimeZones *matched = matchedTimeZones();
+    {
+        QMutexLocker locker(&matched->lock);
+        const auto it = matched->zones.constFind(fingerprint);
+        if (it != matched->zones.constEnd()) {
+            return it.value();
+        }
+    }
+
+    const QTimeZone tz = matchICalTimeZone(icalZone);
+    QMutexLocker locker(&matched->lock);
+    matched->zones.insert(fingerprint, tz);
+    return tz;
+}
+
+QTimeZone ICalTimeZoneParser::matchICalTimeZone(const ICalTimeZone &icalZone)
 {
     const auto phase = icalZone.standard;
     const auto now = QDateTime::currentDateTimeUtc();
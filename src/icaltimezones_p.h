@@ -26,6 +26,7 @@
 
 #include <QTimeZone>
 #include <QHash>
+#include <QReadWriteLock>
 #include <QVector>
 
 #ifndef ICALCOMPONENT_H
@@ -68,11 +69,32 @@ public:
     explicit ICalTimeZoneCache();
 
     void insert(const QByteArray &id, const ICalTimeZone &tz);
+    void clear();
 
+    // Thread-safe, may be called while other threads look up time zones too
     QTimeZone tzForTime(const QDateTime &dt, const QByteArray &tzid) const;
 
 private:
+    // What a TZID stands for, worked out on its first lookup
+    struct ResolvedTimeZone {
+        struct Transition {
+            qint64 utcMSecs;
+            bool daylight;
+        };
+
+        QTimeZone zone;                  // time zone for the TZID
+        QTimeZone daylightZone;          // UTC offset time zone during daylight time, if any
+        QVector<Transition> transitions; // sorted transitions, if daylightZone is valid
+        qint64 firstStandard;            // first transition to standard time
+    };
+
+    ResolvedTimeZone resolve(const QByteArray &tzid) const;
+
     QHash<QByteArray, ICalTimeZone> mCache;
+    mutable QHash<QByteArray, ResolvedTimeZone> mResolved;
+    mutable QReadWriteLock mResolvedLock;
+
+    Q_DISABLE_COPY(ICalTimeZoneCache)
 };
 
 using TimeZoneEarliestDate = QHash<QTimeZone, QDateTime>;
@@ -99,6 +121,7 @@ private:
     ICalTimeZone parseTimeZone(icalcomponent *zone);
     bool parsePhase(icalcomponent *c, bool daylight, ICalTimeZonePhase &phase);
     QTimeZone resolveICalTimeZone(const ICalTimeZone &icalZone);
+    QTimeZone matchICalTimeZone(const ICalTimeZone &icalZone);
 
     ICalTimeZoneCache *mCache;
 };
@@ -35,6 +35,7 @@
 #include "incidence.h"
 #include "calformat.h"
 #include "utils_p.h"
+#include "timezonetable_p.h"
 
 #include <QTextDocument> // for .toHtmlEscaped() and Qt::mightBeRichText()
 #include <QStringList>
@@ -43,6 +44,8 @@
 
 using namespace KCalendarCore;
 
+QAtomicInt KCalendarCore::schedulingIdChanges;
+
 /**
   Private class that helps to provide binary compatibility between releases.
   @internal
@@ -629,11 +632,12 @@ QList<QDateTime> Incidence::startDateTimesForDate(const QDate &date, const QTime
     // Account for possible recurrences going over midnight, while the original event doesn't
     QDate tmpday(date.addDays(-days - 1));
     QDateTime tmp;
+    const TimeZoneTable::Ptr table = TimeZoneTable::forTimeZone(start.timeZone());
     while (tmpday <= date) {
         if (recurrence()->recursOn(tmpday, timeZone)) {
             const QList<QTime> times = recurrence()->recurTimesOn(tmpday, timeZone);
             for (const QTime &time : times) {
-                tmp = QDateTime(tmpday, time, start.timeZone());
+                tmp = table->dateTime(tmpday, time);
                 if (endDateForStart(tmp) >= kdate) {
                     result << tmp;
                 }
@@ -668,12 +672,13 @@ QList<QDateTime> Incidence::startDateTimesForDateTime(const QDateTime &datetime)
     // Account for possible recurrences going over midnight, while the original event doesn't
     QDate tmpday(datetime.date().addDays(-days - 1));
     QDateTime tmp;
+    const TimeZoneTable::Ptr table = TimeZoneTable::forTimeZone(start.timeZone());
     while (tmpday <= datetime.date()) {
         if (recurrence()->recursOn(tmpday, datetime.timeZone())) {
             // Get the times during the day (in start date's time zone) when recurrences happen
             const QList<QTime> times = recurrence()->recurTimesOn(tmpday, start.timeZone());
             for (const QTime &time : times) {
-                tmp = QDateTime(tmpday, time, start.timeZone());
+                tmp = table->dateTime(tmpday, time);
                 if (!(tmp > datetime || endDateForStart(tmp) < datetime)) {
                     result << tmp;
                 }
@@ -933,6 +938,7 @@ void Incidence::setSchedulingID(const QString &sid, const QString &uid)
     if (sid != d->mSchedulingID) {
         d->mSchedulingID = sid;
         setFieldDirty(FieldSchedulingId);
+        schedulingIdChanges.ref();
     }
 }
 
@@ -0,0 +1,263 @@
+/*
+  This file is part of the kcalcore library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with this library; see the file COPYING.LIB.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+#ifndef KCALCORE_INTERVALTREE_P_H
+#define KCALCORE_INTERVALTREE_P_H
+
+#include <QHash>
+
+#include <algorithm>
+
+namespace KCalendarCore {
+
+/**
+  @internal
+
+  An augmented interval tree over closed intervals [start, end].
+
+  The tree is a treap ordered by interval start, where every node also
+  carries the largest end of its subtree. Insertion and removal cost
+  O(log n) on average, and enumerating the intervals overlapping a query
+  window costs O(log n + k) for k results.
+
+  Values must be hashable; each value is stored at most once, inserting
+  an already present value moves it to its new interval.
+*/
+template <typename T>
+class IntervalTree
+{
+public:
+    IntervalTree() = default;
+
+    ~IntervalTree()
+    {
+        clear();
+    }
+
+    /**
+      Inserts @p value covering [@p start, @p end], replacing any interval
+      previously stored for it. An @p end before @p start is treated as an
+      empty interval at @p start.
+    */
+    void insert(const T &value, qint64 start, qint64 end)
+    {
+        remove(value);
+
+        Node *node = new Node;
+        node->start = start;
+        node->end = std::max(start, end);
+        node->maxEnd = node->end;
+        node->serial = ++mSerial;
+        node->priority = nextPriority();
+        node->value = value;
+
+        mKeys.insert(value, Key{start, node->serial});
+        mRoot = insert(mRoot, node);
+    }
+
+    /**
+      Removes @p value from the tree.
+      @return true if @p value was present.
+    */
+    bool remove(const T &value)
+    {
+        const auto it = mKeys.find(value);
+        if (it == mKeys.end()) {
+            return false;
+        }
+        const Key key = it.value();
+        mKeys.erase(it);
+        mRoot = remove(mRoot, key);
+        return true;
+    }
+
+    bool contains(const T &value) const
+    {
+        return mKeys.contains(value);
+    }
+
+    int size() const
+    {
+        return mKeys.size();
+    }
+
+    void clear()
+    {
+        destroy(mRoot);
+        mRoot = nullptr;
+        mKeys.clear();
+    }
+
+    /**
+      Calls @p func for every value whose interval intersects
+      [@p start, @p end], in ascending order of interval start.
+    */
+    template <typename Func>
+    void forEachOverlapping(qint64 start, qint64 end, Func func) const
+    {
+        visit(mRoot, start, end, func);
+    }
+
+private:
+    struct Key {
+        qint64 start;
+        quint64 serial;
+
+        bool operator<(const Key &other) const
+        {
+            return start < other.start || (start == other.start && serial < other.serial);
+        }
+    };
+
+    struct Node {
+        qint64 start;
+        qint64 end;
+        qint64 maxEnd;
+        quint64 serial;
+        quint32 priority;
+        T value;
+        Node *left = nullptr;
+        Node *right = nullptr;
+
+        Key key() const
+        {
+            return Key{start, serial};
+        }
+    };
+
+    static void updateMaxEnd(Node *node)
+    {
+        node->maxEnd = node->end;
+        if (node->left) {
+            node->maxEnd = std::max(node->maxEnd, node->left->maxEnd);
+        }
+        if (node->right) {
+            node->maxEnd = std::max(node->maxEnd, node->right->maxEnd);
+        }
+    }
+
+    static Node *rotateRight(Node *node)
+    {
+        Node *pivot = node->left;
+        node->left = pivot->right;
+        pivot->right = node;
+        updateMaxEnd(node);
+        updateMaxEnd(pivot);
+        return pivot;
+    }
+
+    static Node *rotateLeft(Node *node)
+    {
+        Node *pivot = node->right;
+        node->right = pivot->left;
+        pivot->left = node;
+        updateMaxEnd(node);
+        updateMaxEnd(pivot);
+        return pivot;
+    }
+
+    static Node *insert(Node *root, Node *node)
+    {
+        if (!root) {
+            return node;
+        }
+        if (node->key() < root->key()) {
+            root->left = insert(root->left, node);
+            if (root->left->priority > root->priority) {
+                return rotateRight(root);
+            }
+        } else {
+            root->right = insert(root->right, node);
+            if (root->right->priority > root->priority) {
+                return rotateLeft(root);
+            }
+        }
+        updateMaxEnd(root);
+        return root;
+    }
+
+    static Node *remove(Node *root, const Key &key)
+    {
+        if (!root) {
+            return nullptr;
+        }
+        if (key < root->key()) {
+            root->left = remove(root->left, key);
+        } else if (root->key() < key) {
+            root->right = remove(root->right, key);
+        } else if (!root->left || !root->right) {
+            Node *child = root->left ? root->left : root->right;
+            delete root;
+            return child;
+        } else if (root->left->priority > root->right->priority) {
+            root = rotateRight(root);
+            root->right = remove(root->right, key);
+        } else {
+            root = rotateLeft(root);
+            root->left = remove(root->left, key);
+        }
+        updateMaxEnd(root);
+        return root;
+    }
+
+    template <typename Func>
+    static void visit(const Node *node, qint64 start, qint64 end, Func &func)
+    {
+        if (!node || node->maxEnd < start) {
+            return;
+        }
+        visit(node->left, start, end, func);
+        if (node->start > end) {
+            return;
+        }
+        if (node->end >= start) {
+            func(node->value);
+        }
+        visit(node->right, start, end, func);
+    }
+
+    static void destroy(Node *node)
+    {
+        if (node) {
+            destroy(node->left);
+            destroy(node->right);
+            delete node;
+        }
+    }
+
+    quint32 nextPriority()
+    {
+        // xorshift32, good enough to keep the treap balanced
+        mSeed ^= mSeed << 13;
+        mSeed ^= mSeed >> 17;
+        mSeed ^= mSeed << 5;
+        return mSeed;
+    }
+
+    Node *mRoot = nullptr;
+    QHash<T, Key> mKeys;
+    quint64 mSerial = 0;
+    quint32 mSeed = 2463534242u;
+
+    Q_DISABLE_COPY(IntervalTree)
+};
+
+}
+
+#endif
@@ -34,10 +34,17 @@
 
 #include "memorycalendar.h"
 #include "kcalendarcore_debug.h"
+#include "calendar_p.h"
 #include "calformat.h"
+#include "intervaltree_p.h"
+#include "utils_p.h"
 
+#include <QBitArray>
 #include <QDate>
 
+#include <algorithm>
+#include <limits>
+
 template <typename K, typename V>
 static QVector<V> values(const QMultiHash<K, V> &c)
 {
@@ -72,7 +79,7 @@ class Q_DECL_HIDDEN KCalendarCore::MemoryCalendar::Private
 {
 public:
     Private(MemoryCalendar *qq)
-        : q(qq), mFormat(nullptr)
+        : q(qq), mFormat(nullptr), mSchedulingIdChanges(schedulingIdChanges.loadAcquire())
     {
     }
     ~Private()
@@ -94,6 +101,14 @@ public:
      */
     QHash<QString, KCalendarCore::Incidence::Ptr> mIncidencesByIdentifier;
 
+    /**
+     * Has all incidences, indexed by scheduling identifier. Scheduling
+     * identifiers change without notice, so this is rebuilt by
+     * checkSchedulingIDs() when any of them changed since.
+     */
+    mutable QMultiHash<QString, Incidence::Ptr> mIncidencesBySchedulingID;
+    mutable int mSchedulingIdChanges;
+
     /**
      * List of all deleted incidences.
      * First indexed by incidence->type(), then by incidence->uid();
@@ -105,15 +120,76 @@ public:
      * indexed by start/due date.
      *
      * The QMap key is the incidence->type().
-     * The QMultiHash key is the dtStart/dtDue().toString()
+     * The QMultiMap key is the Julian day of dtStart/dtDue(), so the
+     * incidences of a range of days are found next to each other.
      *
      * Note: We had 3 variables, mJournalsForDate, mTodosForDate and mEventsForDate
      * but i merged them into one (indexed by type) because it simplifies code using
      * it. No need to if else based on type.
      */
-    QMap<IncidenceBase::IncidenceType, QMultiHash<QString, IncidenceBase::Ptr> > mIncidencesForDate;
+    QMap<IncidenceBase::IncidenceType, QMultiMap<qint64, IncidenceBase::Ptr> > mIncidencesForDate;
+
+    /**
+     * Non-recurring events with a valid start, indexed by the time span
+     * [dtStart, dtEnd] they cover, in milliseconds since the epoch.
+     */
+    IntervalTree<Incidence::Ptr> mEventIntervals;
+
+    /**
+     * Recurring events with a valid start, indexed by the span from their
+     * first occurrence to the end of their last one, unbounded for
+     * infinite recurrences.
+     */
+    IntervalTree<Incidence::Ptr> mRecurrenceSpans;
+
+    /**
+     * Events without a valid start, which cannot be indexed by time.
+     */
+    QSet<Incidence::Ptr> mUnindexedEvents;
+
+    /**
+     * Alarms indexed by their next trigger time after mAlarmsDueUntil, in
+     * milliseconds since the epoch.
+     *
+     * mAlarmHeap is a min-heap of trigger times. Entries are not removed
+     * when their incidence changes, instead mAlarmIncidences holds the
+     * generation of the current entries of each incidence and older
+     * entries are dropped when they come up. Changed incidences wait in
+     * mAlarmsToIndex until the index is used.
+     */
+    struct AlarmTrigger {
+        qint64 time;
+        Alarm::Ptr alarm;
+        Incidence::Ptr incidence;
+        quint64 generation;
+    };
+    struct AlarmIncidence {
+        quint64 generation;
+        int triggerCount;
+    };
+    QVector<AlarmTrigger> mAlarmHeap;
+    QHash<Incidence::Ptr, AlarmIncidence> mAlarmIncidences;
+    QSet<Incidence::Ptr> mAlarmsToIndex;
+    quint64 mAlarmGeneration = 0;
+    int mLiveAlarmTriggers = 0;
+    qint64 mAlarmsDueUntil = QDateTime(QDate(1900, 1, 1), QTime(0, 0, 0), Qt::UTC).toMSecsSinceEpoch();
+    bool mAlarmIndexEnabled = false;
 
     void insertIncidence(const Incidence::Ptr &incidence);
+    void checkSchedulingIDs() const;
+    bool insertIncidences(const Incidence::List &incidences);
+
+    void indexEvent(const Incidence::Ptr &incidence);
+    void unindexEvent(const Incidence::Ptr &incidence);
+
+    void scheduleAlarms(const Incidence::Ptr &incidence);
+    void unscheduleAlarms(const Incidence::Ptr &incidence);
+    void indexAlarms(const Incidence::Ptr &incidence);
+    void updateAlarmIndex();
+    static bool laterAlarmTrigger(const AlarmTrigger &a, const AlarmTrigger &b);
+    void pushAlarmTrigger(const AlarmTrigger &trigger);
+    AlarmTrigger takeAlarmTrigger();
+    void dropStaleAlarmTriggers();
 
     Incidence::Ptr incidence(const QString &uid,
                              IncidenceBase::IncidenceType type,
@@ -125,6 +201,9 @@ public:
 
     void deleteAllIncidences(IncidenceBase::IncidenceType type);
 
+    void forEachIncidence(IncidenceBase::IncidenceType type,
+                          const std::function<void(const Incidence::Ptr &)> &func) const;
+
 };
 //@endcond
 
@@ -132,12 +211,16 @@ MemoryCalendar::MemoryCalendar(const QTimeZone &timeZone)
     : Calendar(timeZone),
       d(new KCalendarCore::MemoryCalendar::Private(this))
 {
+    setDirectIncidenceIteration(true);
+    setDirectIncidenceInsertion(true);
 }
 
 MemoryCalendar::MemoryCalendar(const QByteArray &timeZoneId)
     : Calendar(timeZoneId),
       d(new KCalendarCore::MemoryCalendar::Private(this))
 {
+    setDirectIncidenceIteration(true);
+    setDirectIncidenceInsertion(true);
 }
 
 MemoryCalendar::~MemoryCalendar()
@@ -157,7 +240,10 @@ void MemoryCalendar::close()
     d->deleteAllIncidences(Incidence::TypeJournal);
 
     d->mIncidencesByIdentifier.clear();
+    d->mIncidencesBySchedulingID.clear();
     d->mDeletedIncidences.clear();
+    d->mAlarmHeap.clear();
+    d->mLiveAlarmTriggers = 0;
 
     setModified(false);
 
@@ -179,6 +265,7 @@ bool MemoryCalendar::deleteIncidence(const Incidence::Ptr &incidence)
 
         d->mIncidences[type].remove(uid, incidence);
         d->mIncidencesByIdentifier.remove(incidence->instanceIdentifier());
+        d->mIncidencesBySchedulingID.remove(incidence->schedulingID(), incidence);
         setModified(true);
         if (deletionTracking()) {
             d->mDeletedIncidences[type].insert(uid, incidence);
@@ -186,8 +273,12 @@ bool MemoryCalendar::deleteIncidence(const Incidence::Ptr &incidence)
 
         const QDateTime dt = incidence->dateTime(Incidence::RoleCalendarHashing);
         if (dt.isValid()) {
-            d->mIncidencesForDate[type].remove(dt.date().toString(), incidence);
+            d->mIncidencesForDate[type].remove(dt.date().toJulianDay(), incidence);
         }
+        if (type == Incidence::TypeEvent) {
+            d->unindexEvent(incidence);
+        }
+        d->unscheduleAlarms(incidence);
         // Delete child-incidences.
         if (!incidence->hasRecurrenceId()) {
             deleteIncidenceInstances(incidence);
@@ -226,10 +317,35 @@ void MemoryCalendar::Private::deleteAllIncidences(Incidence::IncidenceType incid
     while (i.hasNext()) {
         i.next();
         q->notifyIncidenceAboutToBeDeleted(i.value());
+        q->removeRelations(i.value());
         i.value()->unRegisterObserver(q);
+        unscheduleAlarms(i.value());
     }
     mIncidences[incidenceType].clear();
     mIncidencesForDate[incidenceType].clear();
+    if (incidenceType == Incidence::TypeEvent) {
+        mEventIntervals.clear();
+        mRecurrenceSpans.clear();
+        mUnindexedEvents.clear();
+    }
+}
+
+void MemoryCalendar::Private::forEachIncidence(IncidenceBase::IncidenceType type,
+                                               const std::function<void(const Incidence::Ptr &)> &func) const
+{
+    if (type == Incidence::TypeUnknown) {
+        for (auto t : { Incidence::TypeEvent, Incidence::TypeTodo, Incidence::TypeJournal }) {
+            forEachIncidence(t, func);
+        }
+        return;
+    }
+
+    const auto incidences = mIncidences.constFind(type);
+    if (incidences != mIncidences.constEnd()) {
+        for (auto it = incidences->cbegin(), end = incidences->cend(); it != end; ++it) {
+            func(it.value());
+        }
+    }
 }
 
 Incidence::Ptr MemoryCalendar::Private::incidence(const QString &uid,
@@ -277,6 +393,22 @@ MemoryCalendar::Private::deletedIncidence(const QString &uid,
     return Incidence::Ptr();
 }
 
+void MemoryCalendar::Private::checkSchedulingIDs() const
+{
+    const int changes = schedulingIdChanges.loadAcquire();
+    if (changes == mSchedulingIdChanges) {
+        return;
+    }
+    mSchedulingIdChanges = changes;
+
+    mIncidencesBySchedulingID.clear();
+    for (const auto &incidences : mIncidences) {
+        for (auto it = incidences.cbegin(), end = incidences.cend(); it != end; ++it) {
+            mIncidencesBySchedulingID.insert(it.value()->schedulingID(), it.value());
+        }
+    }
+}
+
 void MemoryCalendar::Private::insertIncidence(const Incidence::Ptr &incidence)
 {
     const QString uid = incidence->uid();
@@ -284,10 +416,15 @@ void MemoryCalendar::Private::insertIncidence(const Incidence::Ptr &incidence)
     if (!mIncidences[type].contains(uid, incidence)) {
         mIncidences[type].insert(uid, incidence);
         mIncidencesByIdentifier.insert(incidence->instanceIdentifier(), incidence);
+        mIncidencesBySchedulingID.insert(incidence->schedulingID(), incidence);
         const QDateTime dt = incidence->dateTime(Incidence::RoleCalendarHashing);
         if (dt.isValid()) {
-            mIncidencesForDate[type].insert(dt.date().toString(), incidence);
+            mIncidencesForDate[type].insert(dt.date().toJulianDay(), incidence);
+        }
+        if (type == Incidence::TypeEvent) {
+            indexEvent(incidence);
         }
+        scheduleAlarms(incidence);
 
     } else {
 #ifndef NDEBUG
@@ -297,6 +434,220 @@ void MemoryCalendar::Private::insertIncidence(const Incidence::Ptr &incidence)
 #endif
     }
 }
+
+bool MemoryCalendar::Private::insertIncidences(const Incidence::List &incidences)
+{
+    bool success = true;
+    Incidence::List inserted;
+    inserted.reserve(incidences.count());
+    QMap<IncidenceBase::IncidenceType, int> counts;
+    for (const Incidence::Ptr &incidence : incidences) {
+        if (!incidence) {
+            success = false;
+            continue;
+        }
+        inserted.append(incidence);
+        ++counts[incidence->type()];
+    }
+    if (inserted.isEmpty()) {
+        return success;
+    }
+
+    // Grow the hashes once instead of rehashing them along the way
+    for (auto it = counts.cbegin(); it != counts.cend(); ++it) {
+        auto &hash = mIncidences[it.key()];
+        hash.reserve(hash.size() + it.value());
+    }
+    mIncidencesByIdentifier.reserve(mIncidencesByIdentifier.size() + inserted.count());
+    mIncidencesBySchedulingID.reserve(mIncidencesBySchedulingID.size() + inserted.count());
+
+    for (const Incidence::Ptr &incidence : qAsConst(inserted)) {
+        insertIncidence(incidence);
+    }
+
+    // Same order as in addIncidence(), so observers learn about the
+    // incidences before any change to them
+    q->notifyIncidencesAdded(inserted);
+
+    for (const Incidence::Ptr &incidence : qAsConst(inserted)) {
+        incidence->registerObserver(q);
+    }
+
+    // Parents are in the calendar by now, wherever they were in the list
+    for (const Incidence::Ptr &incidence : qAsConst(inserted)) {
+        q->setupRelations(incidence);
+    }
+
+    q->setModified(true);
+
+    return success;
+}
+
+/**
+  Returns the span covered by all occurrences of a recurring incidence, in
+  milliseconds since the epoch. The span starts at the earliest of dtStart
+  and the RDATEs, and is unbounded for infinite recurrences.
+*/
+static QPair<qint64, qint64> recurrenceSpan(const Incidence::Ptr &incidence)
+{
+    const Recurrence *recurrence = incidence->recurrence();
+    const QDateTime start = incidence->dtStart();
+
+    QDateTime first = start;
+    const DateList rDates = recurrence->rDates();
+    if (!rDates.isEmpty()) {
+        first = qMin(first, QDateTime(rDates.first(), QTime(0, 0, 0), start.timeZone()));
+    }
+    const QList<QDateTime> rDateTimes = recurrence->rDateTimes();
+    if (!rDateTimes.isEmpty()) {
+        first = qMin(first, rDateTimes.first());
+    }
+
+    const QDateTime last = recurrence->endDateTime();
+    if (!last.isValid()) {
+        return qMakePair(first.toMSecsSinceEpoch(), std::numeric_limits<qint64>::max());
+    }
+    const QDateTime end = incidence->dateTime(Incidence::RoleEnd);
+    const qint64 length = end.isValid() ? qMax<qint64>(0, start.msecsTo(end)) : 0;
+    return qMakePair(first.toMSecsSinceEpoch(), last.toMSecsSinceEpoch() + length);
+}
+
+void MemoryCalendar::Private::indexEvent(const Incidence::Ptr &incidence)
+{
+    const QDateTime start = incidence->dtStart();
+    if (!start.isValid()) {
+        mEventIntervals.remove(incidence);
+        mRecurrenceSpans.remove(incidence);
+        mUnindexedEvents.insert(incidence);
+    } else if (incidence->recurs()) {
+        mEventIntervals.remove(incidence);
+        mUnindexedEvents.remove(incidence);
+        const auto span = recurrenceSpan(incidence);
+        mRecurrenceSpans.insert(incidence, span.first, span.second);
+    } else {
+        mRecurrenceSpans.remove(incidence);
+        mUnindexedEvents.remove(incidence);
+        const QDateTime end = incidence->dateTime(Incidence::RoleEnd);
+        mEventIntervals.insert(incidence, start.toMSecsSinceEpoch(),
+                               end.isValid() ? end.toMSecsSinceEpoch() : start.toMSecsSinceEpoch());
+    }
+}
+
+void MemoryCalendar::Private::unindexEvent(const Incidence::Ptr &incidence)
+{
+    mEventIntervals.remove(incidence);
+    mRecurrenceSpans.remove(incidence);
+    mUnindexedEvents.remove(incidence);
+}
+
+bool MemoryCalendar::Private::laterAlarmTrigger(const AlarmTrigger &a, const AlarmTrigger &b)
+{
+    return a.time > b.time;
+}
+
+void MemoryCalendar::Private::scheduleAlarms(const Incidence::Ptr &incidence)
+{
+    if (mAlarmIndexEnabled) {
+        mAlarmsToIndex.insert(incidence);
+    }
+}
+
+void MemoryCalendar::Private::unscheduleAlarms(const Incidence::Ptr &incidence)
+{
+    mAlarmsToIndex.remove(incidence);
+    const auto it = mAlarmIncidences.find(incidence);
+    if (it != mAlarmIncidences.end()) {
+        // Its entries in the heap are stale from now on
+        mLiveAlarmTriggers -= it->triggerCount;
+        mAlarmIncidences.erase(it);
+    }
+}
+
+void MemoryCalendar::Private::indexAlarms(const Incidence::Ptr &incidence)
+{
+    unscheduleAlarms(incidence);
+
+    // Same incidences as MemoryCalendar::alarms()
+    if (incidence->type() != Incidence::TypeEvent &&
+            (incidence->type() != Incidence::TypeTodo || incidence.staticCast<Todo>()->isCompleted())) {
+        return;
+    }
+
+    const QDateTime after = QDateTime::fromMSecsSinceEpoch(mAlarmsDueUntil, Qt::UTC);
+    const quint64 generation = ++mAlarmGeneration;
+    int triggerCount = 0;
+    const Alarm::List alarms = incidence->alarms();
+    for (const Alarm::Ptr &alarm : alarms) {
+        if (alarm->enabled()) {
+            const QDateTime next = alarm->nextRepetition(after);
+            if (next.isValid()) {
+                pushAlarmTrigger(AlarmTrigger{next.toMSecsSinceEpoch(), alarm, incidence, generation});
+                ++triggerCount;
+            }
+        }
+    }
+    if (triggerCount > 0) {
+        mAlarmIncidences.insert(incidence, AlarmIncidence{generation, triggerCount});
+        mLiveAlarmTriggers += triggerCount;
+    }
+}
+
+void MemoryCalendar::Private::updateAlarmIndex()
+{
+    if (!mAlarmIndexEnabled) {
+        mAlarmIndexEnabled = true;
+        for (auto type : { Incidence::TypeEvent, Incidence::TypeTodo }) {
+            const auto &incidences = mIncidences[type];
+            for (auto it = incidences.cbegin(), end = incidences.cend(); it != end; ++it) {
+                mAlarmsToIndex.insert(it.value());
+            }
+        }
+    }
+
+    const QSet<Incidence::Ptr> incidences = mAlarmsToIndex;
+    mAlarmsToIndex.clear();
+    for (const Incidence::Ptr &incidence : incidences) {
+        indexAlarms(incidence);
+    }
+
+    // Don't let stale entries outnumber the live ones
+    if (mAlarmHeap.count() > 2 * mLiveAlarmTriggers + 64) {
+        const auto stale = [this](const AlarmTrigger &trigger) {
+            const auto it = mAlarmIncidences.constFind(trigger.incidence);
+            return it == mAlarmIncidences.constEnd() || it->generation != trigger.generation;
+        };
+        mAlarmHeap.erase(std::remove_if(mAlarmHeap.begin(), mAlarmHeap.end(), stale), mAlarmHeap.end());
+        std::make_heap(mAlarmHeap.begin(), mAlarmHeap.end(), laterAlarmTrigger);
+    }
+    dropStaleAlarmTriggers();
+}
+
+void MemoryCalendar::Private::pushAlarmTrigger(const AlarmTrigger &trigger)
+{
+    mAlarmHeap.append(trigger);
+    std::push_heap(mAlarmHeap.begin(), mAlarmHeap.end(), laterAlarmTrigger);
+}
+
+MemoryCalendar::Private::AlarmTrigger MemoryCalendar::Private::takeAlarmTrigger()
+{
+    std::pop_heap(mAlarmHeap.begin(), mAlarmHeap.end(), laterAlarmTrigger);
+    const AlarmTrigger trigger = mAlarmHeap.takeLast();
+    dropStaleAlarmTriggers();
+    return trigger;
+}
+
+void MemoryCalendar::Private::dropStaleAlarmTriggers()
+{
+    while (!mAlarmHeap.isEmpty()) {
+        const AlarmTrigger &top = mAlarmHeap.first();
+        const auto it = mAlarmIncidences.constFind(top.incidence);
+        if (it != mAlarmIncidences.constEnd() && it->generation == top.generation) {
+            return;
+        }
+        std::pop_heap(mAlarmHeap.begin(), mAlarmHeap.end(), laterAlarmTrigger);
+        mAlarmHeap.removeLast();
+    }
+}
 //@endcond
 
 bool MemoryCalendar::addIncidence(const Incidence::Ptr &incidence)
@@ -418,10 +769,10 @@ Todo::List MemoryCalendar::rawTodosForDate(const QDate &date) const
     Todo::List todoList;
     Todo::Ptr t;
 
-    const QString dateStr = date.toString();
-    QMultiHash<QString, IncidenceBase::Ptr >::const_iterator it =
-        d->mIncidencesForDate[Incidence::TypeTodo].constFind(dateStr);
-    while (it != d->mIncidencesForDate[Incidence::TypeTodo].constEnd() && it.key() == dateStr) {
+    const qint64 day = date.toJulianDay();
+    QMultiMap<qint64, IncidenceBase::Ptr >::const_iterator it =
+        d->mIncidencesForDate[Incidence::TypeTodo].constFind(day);
+    while (it != d->mIncidencesForDate[Incidence::TypeTodo].constEnd() && it.key() == day) {
         t = it.value().staticCast<Todo>();
         todoList.append(t);
         ++it;
@@ -540,6 +891,51 @@ Alarm::List MemoryCalendar::alarms(const QDateTime &from, const QDateTime &to, b
     return alarmList;
 }
 
+QDateTime MemoryCalendar::nextAlarmTime() const
+{
+    d->updateAlarmIndex();
+    if (d->mAlarmHeap.isEmpty()) {
+        return QDateTime();
+    }
+    return QDateTime::fromMSecsSinceEpoch(d->mAlarmHeap.first().time, Qt::UTC);
+}
+
+Alarm::List MemoryCalendar::alarmsDue(const QDateTime &until)
+{
+    d->updateAlarmIndex();
+
+    Alarm::List alarmList;
+    const qint64 end = until.toMSecsSinceEpoch();
+    if (end <= d->mAlarmsDueUntil) {
+        return alarmList;
+    }
+
+    QVector<Private::AlarmTrigger> fired;
+    while (!d->mAlarmHeap.isEmpty() && d->mAlarmHeap.first().time <= end) {
+        fired.append(d->takeAlarmTrigger());
+        alarmList.append(fired.last().alarm);
+    }
+
+    // Fired alarms are due again at their next trigger after 'until'
+    d->mAlarmsDueUntil = end;
+    for (Private::AlarmTrigger &trigger : fired) {
+        const QDateTime next = trigger.alarm->nextRepetition(until);
+        if (next.isValid()) {
+            trigger.time = next.toMSecsSinceEpoch();
+            d->pushAlarmTrigger(trigger);
+        } else {
+            auto it = d->mAlarmIncidences.find(trigger.incidence);
+            --d->mLiveAlarmTriggers;
+            if (--it->triggerCount == 0) {
+                d->mAlarmIncidences.erase(it);
+            }
+        }
+    }
+    d->dropStaleAlarmTriggers();
+
+    return alarmList;
+}
+
 void MemoryCalendar::incidenceUpdate(const QString &uid, const QDateTime &recurrenceId)
 {
     Incidence::Ptr inc = incidence(uid, recurrenceId);
@@ -551,11 +947,12 @@ void MemoryCalendar::incidenceUpdate(const QString &uid, const QDateTime &recurr
 
         // Save it so we can detect changes to uid or recurringId.
         d->mIncidenceBeingUpdated = inc->instanceIdentifier();
+        d->mIncidencesBySchedulingID.remove(inc->schedulingID(), inc);
 
         const QDateTime dt = inc->dateTime(Incidence::RoleCalendarHashing);
         if (dt.isValid()) {
             const Incidence::IncidenceType type = inc->type();
-            d->mIncidencesForDate[type].remove(dt.date().toString(), inc);
+            d->mIncidencesForDate[type].remove(dt.date().toJulianDay(), inc);
         }
     }
 }
@@ -575,6 +972,9 @@ void MemoryCalendar::incidenceUpdated(const QString &uid, const QDateTime &recur
         }
 
         d->mIncidenceBeingUpdated = QString();
+        if (!d->mIncidencesBySchedulingID.contains(inc->schedulingID(), inc)) {
+            d->mIncidencesBySchedulingID.insert(inc->schedulingID(), inc);
+        }
 
         inc->setLastModified(QDateTime::currentDateTimeUtc());
         // we should probably update the revision number here,
@@ -584,12 +984,19 @@ void MemoryCalendar::incidenceUpdated(const QString &uid, const QDateTime &recur
         const QDateTime dt = inc->dateTime(Incidence::RoleCalendarHashing);
         if (dt.isValid()) {
             const Incidence::IncidenceType type = inc->type();
-            d->mIncidencesForDate[type].insert(dt.date().toString(), inc);
+            d->mIncidencesForDate[type].insert(dt.date().toJulianDay(), inc);
+        }
+        if (inc->type() == Incidence::TypeEvent) {
+            d->indexEvent(inc);
         }
+        d->scheduleAlarms(inc);
 
         notifyIncidenceChanged(inc);
 
         setModified(true);
+
+        // Follow changes of the related-to uid
+        setupRelations(inc);
     }
 }
 
@@ -608,12 +1015,12 @@ Event::List MemoryCalendar::rawEventsForDate(const QDate &date,
     Event::Ptr ev;
 
     // Find the hash for the specified date
-    const QString dateStr = date.toString();
-    QMultiHash<QString, IncidenceBase::Ptr >::const_iterator it =
-        d->mIncidencesForDate[Incidence::TypeEvent].constFind(dateStr);
+    const qint64 day = date.toJulianDay();
+    QMultiMap<qint64, IncidenceBase::Ptr >::const_iterator it =
+        d->mIncidencesForDate[Incidence::TypeEvent].constFind(day);
     // Iterate over all non-recurring, single-day events that start on this date
     const auto ts = timeZone.isValid() ? timeZone : this->timeZone();
-    while (it != d->mIncidencesForDate[Incidence::TypeEvent].constEnd() && it.key() == dateStr) {
+    while (it != d->mIncidencesForDate[Incidence::TypeEvent].constEnd() && it.key() == day) {
         ev = it.value().staticCast<Event>();
         QDateTime end(ev->dtEnd().toTimeZone(ev->dtStart().timeZone()));
         if (ev->allDay()) {
@@ -627,19 +1034,17 @@ Event::List MemoryCalendar::rawEventsForDate(const QDate &date,
         ++it;
     }
 
-    // Iterate over all events. Look for recurring events that occur on this date
-    QHashIterator<QString, Incidence::Ptr>i(d->mIncidences[Incidence::TypeEvent]);
-    while (i.hasNext()) {
-        i.next();
-        ev = i.value().staticCast<Event>();
+    // Look for recurring events that occur on this date. Only the series whose
+    // span reaches this date can match; the margin covers UTC offsets and
+    // occurrences of multi-day events starting on previous days.
+    const QDateTime dayStart(date, QTime(0, 0, 0), Qt::UTC);
+    auto checkRecurring = [&](const Incidence::Ptr &incidence) {
+        ev = incidence.staticCast<Event>();
         if (ev->recurs()) {
             if (ev->isMultiDay()) {
                 int extraDays = ev->dtStart().date().daysTo(ev->dtEnd().date());
-                for (int i = 0; i <= extraDays; ++i) {
-                    if (ev->recursOn(date.addDays(-i), ts)) {
-                        eventList.append(ev);
-                        break;
-                    }
+                if (ev->recurrence()->recurrenceDays(date.addDays(-extraDays), date, ts).count(true) > 0) {
+                    eventList.append(ev);
                 }
             } else {
                 if (ev->recursOn(date, ts)) {
@@ -653,8 +1058,27 @@ Event::List MemoryCalendar::rawEventsForDate(const QDate &date,
                 }
             }
         }
+    };
+    d->mRecurrenceSpans.forEachOverlapping(dayStart.addDays(-3).toMSecsSinceEpoch(),
+                                           dayStart.addDays(3).toMSecsSinceEpoch(),
+                                           checkRecurring);
+    for (const Incidence::Ptr &incidence : qAsConst(d->mUnindexedEvents)) {
+        checkRecurring(incidence);
     }
 
+    // Look for non-recurring multi-day events spanning this date. The dates are
+    // compared in each event's own time zone, so widen the window by enough to
+    // cover any UTC offset and let the exact check below do the filtering.
+    d->mEventIntervals.forEachOverlapping(dayStart.addDays(-2).toMSecsSinceEpoch(),
+                                          dayStart.addDays(3).toMSecsSinceEpoch(),
+                                          [&](const Incidence::Ptr &incidence) {
+        const Event::Ptr event = incidence.staticCast<Event>();
+        if (event->isMultiDay() &&
+                event->dtStart().date() <= date && event->dtEnd().date() >= date) {
+            eventList.append(event);
+        }
+    });
+
     return Calendar::sortEvents(eventList, sortField, sortDirection);
 }
 
@@ -668,52 +1092,71 @@ Event::List MemoryCalendar::rawEvents(const QDate &start,
     QDateTime st(start, QTime(0, 0, 0), ts);
     QDateTime nd(end, QTime(23, 59, 59, 999), ts);
 
-    // Get non-recurring events
-    QHashIterator<QString, Incidence::Ptr>i(d->mIncidences[Incidence::TypeEvent]);
-    Event::Ptr event;
-    while (i.hasNext()) {
-        i.next();
-        event = i.value().staticCast<Event>();
+    auto matches = [&](const Event::Ptr &event) {
         QDateTime rStart = event->dtStart();
         if (nd < rStart) {
-            continue;
+            return false;
         }
         if (inclusive && rStart < st) {
-            continue;
+            return false;
         }
 
         if (!event->recurs()) {   // non-recurring events
             QDateTime rEnd = event->dtEnd();
             if (rEnd < st) {
-                continue;
+                return false;
             }
             if (inclusive && nd < rEnd) {
-                continue;
+                return false;
             }
         } else { // recurring events
             switch (event->recurrence()->duration()) {
             case -1: // infinite
                 if (inclusive) {
-                    continue;
+                    return false;
                 }
                 break;
             case 0: // end date given
             default: // count given
                 QDateTime rEnd(event->recurrence()->endDate(), QTime(23, 59, 59, 999), ts);
                 if (!rEnd.isValid()) {
-                    continue;
+                    return false;
                 }
                 if (rEnd < st) {
-                    continue;
+                    return false;
                 }
                 if (inclusive && nd < rEnd) {
-                    continue;
+                    return false;
                 }
                 break;
             } // switch(duration)
         } //if(recurs)
 
-        eventList.append(event);
+        return true;
+    };
+
+    // Get non-recurring events
+    d->mEventIntervals.forEachOverlapping(st.toMSecsSinceEpoch(), nd.toMSecsSinceEpoch(),
+                                          [&](const Incidence::Ptr &incidence) {
+        const Event::Ptr event = incidence.staticCast<Event>();
+        if (matches(event)) {
+            eventList.append(event);
+        }
+    });
+
+    // Get recurring events, skipping the series which ended before the
+    // window. The end of a finite series is compared by date in the
+    // requested time zone, hence the margin.
+    auto addIfMatches = [&](const Incidence::Ptr &incidence) {
+        const Event::Ptr event = incidence.staticCast<Event>();
+        if (matches(event)) {
+            eventList.append(event);
+        }
+    };
+    d->mRecurrenceSpans.forEachOverlapping(st.addDays(-3).toMSecsSinceEpoch(),
+                                           nd.toMSecsSinceEpoch(), addIfMatches);
+    for (const Incidence::Ptr &incidence : qAsConst(d->mUnindexedEvents)) {
+        addIfMatches(incidence);
     }
 
     return eventList;
@@ -846,11 +1289,11 @@ Journal::List MemoryCalendar::rawJournalsForDate(const QDate &date) const
     Journal::List journalList;
     Journal::Ptr j;
 
-    QString dateStr = date.toString();
-    QMultiHash<QString, IncidenceBase::Ptr >::const_iterator it =
-        d->mIncidencesForDate[Incidence::TypeJournal].constFind(dateStr);
+    const qint64 day = date.toJulianDay();
+    QMultiMap<qint64, IncidenceBase::Ptr >::const_iterator it =
+        d->mIncidencesForDate[Incidence::TypeJournal].constFind(day);
 
-    while (it != d->mIncidencesForDate[Incidence::TypeJournal].constEnd() && it.key() == dateStr) {
+    while (it != d->mIncidencesForDate[Incidence::TypeJournal].constEnd() && it.key() == day) {
         j = it.value().staticCast<Journal>();
         journalList.append(j);
         ++it;
@@ -863,6 +1306,43 @@ Incidence::Ptr MemoryCalendar::instance(const QString &identifier) const
     return d->mIncidencesByIdentifier.value(identifier);
 }
 
+Incidence::Ptr MemoryCalendar::incidenceFromSchedulingID(const QString &sid) const
+{
+    d->checkSchedulingIDs();
+    return d->mIncidencesBySchedulingID.value(sid);
+}
+
+Incidence::List MemoryCalendar::incidencesFromSchedulingID(const QString &sid) const
+{
+    d->checkSchedulingIDs();
+    return ::values(d->mIncidencesBySchedulingID, sid);
+}
+
+void MemoryCalendar::setDirectIncidenceIteration(bool enabled)
+{
+    if (enabled) {
+        const Private *const storage = d;
+        Calendar::d->mForEachIncidence = [storage](IncidenceBase::IncidenceType type,
+                                                   const std::function<void(const Incidence::Ptr &)> &func) {
+            storage->forEachIncidence(type, func);
+        };
+    } else {
+        Calendar::d->mForEachIncidence = nullptr;
+    }
+}
+
+void MemoryCalendar::setDirectIncidenceInsertion(bool enabled)
+{
+    if (enabled) {
+        Private *const storage = d;
+        Calendar::d->mInsertIncidences = [storage](const Incidence::List &incidences) {
+            return storage->insertIncidences(incidences);
+        };
+    } else {
+        Calendar::d->mInsertIncidences = nullptr;
+    }
+}
+
 void MemoryCalendar::virtual_hook(int id, void *data)
 {
     Q_UNUSED(id);
@@ -301,6 +301,52 @@ public:
     */
     Q_REQUIRED_RESULT Alarm::List alarmsTo(const QDateTime &to) const;
 
+    /**
+      Returns the time of the next alarm due after the time up to which
+      alarmsDue() reported alarms, or an invalid QDateTime if there is none.
+
+      Enabled alarms of events and uncompleted to-dos are kept ordered by
+      their next trigger time, which is only recomputed for incidences
+      that changed and for alarms that were reported. The index is built
+      by the first call to this method or to alarmsDue().
+
+      @see alarmsDue()
+      @since 5.64
+    */
+    Q_REQUIRED_RESULT QDateTime nextAlarmTime() const;
+
+    /**
+      Returns the alarms that trigger after the time up to which the
+      previous call reported alarms, and at or before @p until. The first
+      call reports the alarms since 1900, like alarmsTo() does.
+
+      Each alarm is returned at most once per call, in the order of the
+      trigger times, and is then due again at its next trigger time after
+      @p until. This costs O(log n) for each returned alarm, so it suits
+      reminder services which poll a large calendar.
+
+      @param until is the time up to which alarms are reported.
+      @see nextAlarmTime()
+      @since 5.64
+    */
+    Alarm::List alarmsDue(const QDateTime &until);
+
+    /**
+      @copydoc Calendar::incidenceFromSchedulingID()
+
+      The lookup takes constant time, except for the first one after a
+      scheduling ID was changed with Incidence::setSchedulingID().
+    */
+    Q_REQUIRED_RESULT Incidence::Ptr incidenceFromSchedulingID(const QString &sid) const override;
+
+    /**
+      @copydoc Calendar::incidencesFromSchedulingID()
+
+      The lookup takes constant time, except for the first one after a
+      scheduling ID was changed with Incidence::setSchedulingID().
+    */
+    Q_REQUIRED_RESULT Incidence::List incidencesFromSchedulingID(const QString &sid) const override;
+
     /**
       @copydoc Calendar::incidenceUpdate(const QString &,const QDateTime &)
     */
@@ -314,6 +360,33 @@ public:
     using QObject::event;   // prevent warning about hidden virtual method
 
 protected:
+    /**
+      Sets whether Calendar::forEachIncidence() goes through the incidences
+      stored in this calendar directly, instead of through rawEvents(),
+      rawTodos() and rawJournals(). This saves copying the lists when
+      formats write the calendar or incidences are looked up.
+
+      It is enabled by default. Subclasses which reimplement rawEvents(),
+      rawTodos() or rawJournals() must disable it.
+
+      @param enabled whether the incidences are gone through directly.
+      @since 5.64
+    */
+    void setDirectIncidenceIteration(bool enabled);
+
+    /**
+      Sets whether Calendar::addIncidences(), which ICalFormat uses to
+      load calendars, inserts the incidences into this calendar directly,
+      instead of through addIncidence() for each of them.
+
+      It is enabled by default. Subclasses which reimplement addIncidence(),
+      addEvent(), addTodo() or addJournal() must disable it.
+
+      @param enabled whether the incidences are inserted directly.
+      @since 5.64
+    */
+    void setDirectIncidenceInsertion(bool enabled);
+
     /**
       @copydoc IncidenceBase::virtual_hook()
     */
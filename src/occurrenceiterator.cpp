@@ -35,6 +35,8 @@
 
 #include <QDate>
 
+#include <algorithm>
+
 using namespace KCalendarCore;
 
 /**
@@ -54,6 +56,8 @@ public:
     OccurrenceIterator *q;
     QDateTime start;
     QDateTime end;
+    IterationMode mode = Eager;
+    const Calendar *calendar = nullptr;
 
     struct Occurrence {
         Occurrence()
@@ -73,6 +77,42 @@ public:
     QListIterator<Occurrence> occurrenceIt;
     Occurrence current;
 
+    /*
+     * Lazy mode: the position of the iteration in one recurring incidence.
+     * Exceptions which only replace a single occurrence are queued
+     * separately, so that they are returned at their own start date.
+     */
+    struct SeriesCursor {
+        Incidence::Ptr incidence;
+        QHash<QDateTime, Incidence::Ptr> recurrenceIds;
+        QDateTime nextRecurrenceId;
+        // the last THISANDFUTURE exception seen, and its offset
+        Incidence::Ptr activeIncidence;
+        qint64 activeOffset = 0;
+    };
+
+    /*
+     * Lazy mode: a pending occurrence. cursor is the index of the series
+     * to advance once this occurrence has been consumed, or -1.
+     */
+    struct PendingOccurrence {
+        Occurrence occurrence;
+        int cursor;
+        quint64 sequence;
+
+        // std::push_heap() builds a max-heap, so order by descending start
+        bool operator<(const PendingOccurrence &other) const
+        {
+            if (occurrence.startDate != other.occurrence.startDate) {
+                return other.occurrence.startDate < occurrence.startDate;
+            }
+            return other.sequence < sequence;
+        }
+    };
+    QVector<SeriesCursor> cursors;
+    QVector<PendingOccurrence> pending;
+    quint64 sequence = 0;
+
     /*
      * KCalendarCore::CalFilter can't handle individual occurrences.
      * When filtering completed to-dos, the CalFilter doesn't hide
@@ -112,10 +152,11 @@ public:
                 //const bool isAllDay = inc->allDay();
                 const auto lstInstances = calendar.instances(inc);
                 for (const Incidence::Ptr &exception : lstInstances) {
+                    // QDateTime hashes and compares the instant, whatever the
+                    // time zone, so the recurrence id needs no conversion to
+                    // look it up among the occurrences
                     if (incidenceRecStart.isValid()) {
-                        recurrenceIds.insert(
-                            exception->recurrenceId().toTimeZone(incidenceRecStart.timeZone()),
-                            exception);
+                        recurrenceIds.insert(exception->recurrenceId(), exception);
                     }
                 }
                 const auto occurrences = inc->recurrence()->timesInInterval(start, end);
@@ -160,16 +201,116 @@ public:
         }
         occurrenceIt = QListIterator<Private::Occurrence>(occurrenceList);
     }
+
+    void push(const Occurrence &occurrence, int cursor)
+    {
+        pending.push_back(PendingOccurrence{occurrence, cursor, sequence++});
+        std::push_heap(pending.begin(), pending.end());
+    }
+
+    QDateTime firstRecurrenceId(const Incidence::Ptr &inc) const
+    {
+        if (!start.isValid()) {
+            return inc->recurrence()->getNextDateTime(
+                       inc->dateTime(Incidence::RoleRecurrenceStart).addSecs(-1));
+        }
+        return inc->recurrence()->recursAt(start) ? start : inc->recurrence()->getNextDateTime(start);
+    }
+
+    // Queues the next occurrence of the series at @p index, if any
+    void advance(const Calendar &calendar, int index)
+    {
+        SeriesCursor &cursor = cursors[index];
+        while (cursor.nextRecurrenceId.isValid() &&
+                (!end.isValid() || cursor.nextRecurrenceId <= end)) {
+            const QDateTime recurrenceId = cursor.nextRecurrenceId;
+            cursor.nextRecurrenceId = cursor.incidence->recurrence()->getNextDateTime(recurrenceId);
+
+            Incidence::Ptr incidence = cursor.activeIncidence;
+            QDateTime occurrenceStartDate = recurrenceId;
+
+            const Incidence::Ptr exception = cursor.recurrenceIds.value(recurrenceId);
+            if (exception) {
+                if (exception->status() == Incidence::StatusCanceled ||
+                        !exception->thisAndFuture()) {
+                    // cancelled, or already queued by setupLazyIterator()
+                    continue;
+                }
+                incidence = exception;
+                occurrenceStartDate = exception->dtStart();
+                cursor.activeIncidence = exception;
+                cursor.activeOffset = exception->recurrenceId().secsTo(exception->dtStart());
+            } else if (incidence != cursor.incidence) {   //thisAndFuture exception is active
+                occurrenceStartDate = occurrenceStartDate.addSecs(cursor.activeOffset);
+            }
+
+            if (!occurrenceIsHidden(calendar, incidence, occurrenceStartDate)) {
+                push(Occurrence(incidence, recurrenceId, occurrenceStartDate), index);
+                return;
+            }
+        }
+    }
+
+    void setupLazyIterator(const Calendar &calendar, const Incidence::List &incidences)
+    {
+        for (const Incidence::Ptr &inc : qAsConst(incidences)) {
+            if (inc->hasRecurrenceId()) {
+                continue;
+            }
+            if (!inc->recurs()) {
+                push(Occurrence(inc, {}, inc->dtStart()), -1);
+                continue;
+            }
+
+            SeriesCursor cursor;
+            cursor.incidence = inc;
+            cursor.activeIncidence = inc;
+            const QDateTime incidenceRecStart = inc->dateTime(Incidence::RoleRecurrenceStart);
+            const auto lstInstances = calendar.instances(inc);
+            for (const Incidence::Ptr &exception : lstInstances) {
+                if (!incidenceRecStart.isValid()) {
+                    continue;
+                }
+                const QDateTime recurrenceId =
+                    exception->recurrenceId().toTimeZone(incidenceRecStart.timeZone());
+                cursor.recurrenceIds.insert(recurrenceId, exception);
+
+                // Exceptions replacing a single occurrence in the range are
+                // queued right away, at their own start date
+                if (exception->thisAndFuture() ||
+                        exception->status() == Incidence::StatusCanceled ||
+                        (start.isValid() && recurrenceId < start) ||
+                        (end.isValid() && recurrenceId > end) ||
+                        !inc->recurrence()->recursAt(recurrenceId) ||
+                        occurrenceIsHidden(calendar, exception, exception->dtStart())) {
+                    continue;
+                }
+                push(Occurrence(exception, recurrenceId, exception->dtStart()), -1);
+            }
+            cursor.nextRecurrenceId = firstRecurrenceId(inc);
+
+            cursors.push_back(cursor);
+            advance(calendar, cursors.count() - 1);
+        }
+    }
+
+    void setup(const Calendar &calendar, const Incidence::List &incidences)
+    {
+        if (mode == Lazy) {
+            setupLazyIterator(calendar, incidences);
+        } else {
+            setupIterator(calendar, incidences);
+        }
+    }
 };
 //@endcond
 
 /**
- * Right now there is little point in the iterator, but:
- * With an iterator it should be possible to solve this more memory efficiently
- * and with immediate results at the beginning of the selected timeframe.
- * Either all events are iterated simoulatneously, resulting in occurrences
- * of all events in parallel in the correct time-order, or incidence after
- * incidence, which would be even more efficient.
+ * In Eager mode all occurrences are expanded up front, incidence after
+ * incidence. Lazy mode iterates all incidences simultaneously instead,
+ * keeping only the next occurrence of each one in a heap, which results in
+ * occurrences of all events in the correct time-order and gives immediate
+ * results at the beginning of the selected timeframe.
  *
  * By making this class a friend of calendar, we could also use the internally
  * available data structures.
@@ -177,10 +318,20 @@ public:
 OccurrenceIterator::OccurrenceIterator(const Calendar &calendar,
                                        const QDateTime &start,
                                        const QDateTime &end)
+    : OccurrenceIterator(calendar, start, end, Eager)
+{
+}
+
+OccurrenceIterator::OccurrenceIterator(const Calendar &calendar,
+                                       const QDateTime &start,
+                                       const QDateTime &end,
+                                       IterationMode mode)
     : d(new KCalendarCore::OccurrenceIterator::Private(this))
 {
     d->start = start;
     d->end = end;
+    d->mode = mode;
+    d->calendar = &calendar;
 
     Event::List events = calendar.rawEvents(start.date(), end.date(), start.timeZone());
     if (calendar.filter()) {
@@ -209,19 +360,30 @@ OccurrenceIterator::OccurrenceIterator(const Calendar &calendar,
 
     const Incidence::List incidences =
         KCalendarCore::Calendar::mergeIncidenceList(events, todos, journals);
-    d->setupIterator(calendar, incidences);
+    d->setup(calendar, incidences);
 }
 
 OccurrenceIterator::OccurrenceIterator(const Calendar &calendar,
                                        const Incidence::Ptr &incidence,
                                        const QDateTime &start,
                                        const QDateTime &end)
+    : OccurrenceIterator(calendar, incidence, start, end, Eager)
+{
+}
+
+OccurrenceIterator::OccurrenceIterator(const Calendar &calendar,
+                                       const Incidence::Ptr &incidence,
+                                       const QDateTime &start,
+                                       const QDateTime &end,
+                                       IterationMode mode)
     : d(new KCalendarCore::OccurrenceIterator::Private(this))
 {
     Q_ASSERT(incidence);
     d->start = start;
     d->end = end;
-    d->setupIterator(calendar, Incidence::List() << incidence);
+    d->mode = mode;
+    d->calendar = &calendar;
+    d->setup(calendar, Incidence::List() << incidence);
 }
 
 OccurrenceIterator::~OccurrenceIterator()
@@ -230,11 +392,23 @@ OccurrenceIterator::~OccurrenceIterator()
 
 bool OccurrenceIterator::hasNext() const
 {
+    if (d->mode == Lazy) {
+        return !d->pending.isEmpty();
+    }
     return d->occurrenceIt.hasNext();
 }
 
 void OccurrenceIterator::next()
 {
+    if (d->mode == Lazy) {
+        std::pop_heap(d->pending.begin(), d->pending.end());
+        const Private::PendingOccurrence next = d->pending.takeLast();
+        d->current = next.occurrence;
+        if (next.cursor >= 0) {
+            d->advance(*d->calendar, next.cursor);
+        }
+        return;
+    }
     d->current = d->occurrenceIt.next();
 }
 
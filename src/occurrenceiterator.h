@@ -41,12 +41,22 @@ class Calendar;
  *
  * The iterator takes recurrences and exceptions to recurrences into account
  *
- * The iterator does not iterate the occurrences of all incidences chronologically.
+ * By default the iterator does not iterate the occurrences of all incidences
+ * chronologically; use the Lazy IterationMode for that.
  * @since 4.11
  */
 class KCALENDARCORE_EXPORT OccurrenceIterator
 {
 public:
+    /**
+     * How the occurrences are computed.
+     * @since 5.64
+     */
+    enum IterationMode {
+        Eager, /**< All occurrences are expanded up front, incidence after incidence */
+        Lazy   /**< Occurrences are expanded one at a time, in chronological order */
+    };
+
     /**
      * Creates iterator that iterates over all occurrences of all incidences
      * between @param start and @param end (inclusive)
@@ -63,6 +73,34 @@ public:
                        const KCalendarCore::Incidence::Ptr &incidence,
                        const QDateTime &start = QDateTime(),
                        const QDateTime &end = QDateTime());
+
+    /**
+     * Creates iterator that iterates over all occurrences of all incidences
+     * between @param start and @param end (inclusive), using @param mode.
+     *
+     * In Lazy mode the iterator only keeps the next pending occurrence of
+     * each incidence, and returns the occurrences of all incidences ordered
+     * by their start date. Exceptions are returned at their own start date.
+     * The calendar is queried while iterating, so it must outlive the iterator.
+     * @since 5.64
+     */
+    OccurrenceIterator(const Calendar &calendar,
+                       const QDateTime &start,
+                       const QDateTime &end,
+                       IterationMode mode);
+
+    /**
+     * Creates iterator that iterates over all occurrences
+     * of @param incidence between @param start and @param end (inclusive),
+     * using @param mode.
+     * @since 5.64
+     */
+    OccurrenceIterator(const Calendar &calendar,
+                       const KCalendarCore::Incidence::Ptr &incidence,
+                       const QDateTime &start,
+                       const QDateTime &end,
+                       IterationMode mode);
+
     ~OccurrenceIterator();
     bool hasNext() const;
 
@@ -24,6 +24,7 @@
 #include "recurrence.h"
 #include "utils_p.h"
 #include "recurrencehelper_p.h"
+#include "timezonetable_p.h"
 
 #include "kcalendarcore_debug.h"
 
@@ -70,6 +71,7 @@ public:
 
     // Cache the type of the recurrence with the old system (e.g. MonthlyPos)
     mutable ushort mCachedType;
+    mutable TimeZoneTable::Ptr mZoneTable;  // last table used, see TimeZoneTable::forTimeZone()
 
     bool mAllDay = false;                // the recurrence has no time, just a date
     bool mRecurReadOnly = false;
@@ -357,8 +359,11 @@ bool Recurrence::recursOn(const QDate &qd, const QTimeZone &timeZone) const
 
     // Check if it might recur today at all.
     bool recurs = (startDate() == qd);
-    for (i = 0, end = d->mRDateTimes.count();  i < end && !recurs;  ++i) {
-        recurs = (d->mRDateTimes[i].toTimeZone(timeZone).date() == qd);
+    if (!recurs && !d->mRDateTimes.isEmpty()) {
+        const TimeZoneTable::Ptr &table = TimeZoneTable::forTimeZone(timeZone, d->mZoneTable);
+        for (i = 0, end = d->mRDateTimes.count();  i < end && !recurs;  ++i) {
+            recurs = (table->localDate(d->mRDateTimes[i]) == qd);
+        }
     }
     for (i = 0, end = d->mRRules.count();  i < end && !recurs;  ++i) {
         recurs = d->mRRules[i]->recursOn(qd, timeZone);
@@ -370,8 +375,11 @@ bool Recurrence::recursOn(const QDate &qd, const QTimeZone &timeZone) const
 
     // Check if there are any times for this day excluded, either by exdate or exrule:
     bool exon = false;
-    for (i = 0, end = d->mExDateTimes.count();  i < end && !exon;  ++i) {
-        exon = (d->mExDateTimes[i].toTimeZone(timeZone).date() == qd);
+    if (!d->mExDateTimes.isEmpty()) {
+        const TimeZoneTable::Ptr &table = TimeZoneTable::forTimeZone(timeZone, d->mZoneTable);
+        for (i = 0, end = d->mExDateTimes.count();  i < end && !exon;  ++i) {
+            exon = (table->localDate(d->mExDateTimes[i]) == qd);
+        }
     }
     if (!allDay()) {       // we have already checked all-day times above
         for (i = 0, end = d->mExRules.count();  i < end && !exon;  ++i) {
@@ -392,6 +400,74 @@ bool Recurrence::recursOn(const QDate &qd, const QTimeZone &timeZone) const
     }
 }
 
+QBitArray Recurrence::recurrenceDays(const QDate &from, const QDate &to, const QTimeZone &timeZone) const
+{
+    if (!from.isValid() || !to.isValid() || to < from) {
+        return QBitArray();
+    }
+    const int count = from.daysTo(to) + 1;
+    QBitArray days(count);
+
+    // Exception rules and date/times may remove only some of the times on a
+    // day, so in that case check every day separately.
+    if (!d->mExRules.isEmpty() || !d->mExDateTimes.isEmpty()) {
+        for (int i = 0;  i < count;  ++i) {
+            days.setBit(i, recursOn(from.addDays(i), timeZone));
+        }
+        return days;
+    }
+
+    auto setDay = [&](const QDate &date) {
+        const qint64 i = from.daysTo(date);
+        if (i >= 0 && i < count) {
+            days.setBit(i);
+        }
+    };
+    const TimeZoneTable::Ptr table = TimeZoneTable::forTimeZone(timeZone, d->mZoneTable);
+
+    setDay(startDate());
+    for (const QDate &date : qAsConst(d->mRDates)) {
+        setDay(date);
+    }
+    for (const QDateTime &dt : qAsConst(d->mRDateTimes)) {
+        setDay(table->localDate(dt));
+    }
+
+    // Like recursOn(), date-only rules ignore the time zone
+    const QTimeZone tz = allDay() ? d->mStartDateTime.timeZone() : timeZone;
+    const QDateTime start(from, QTime(0, 0, 0), tz);
+    const QDateTime end(to, QTime(23, 59, 59, 999), tz);
+    for (const RecurrenceRule *rule : qAsConst(d->mRRules)) {
+        const auto times = rule->timesInInterval(start, end);
+        if (!times.isEmpty() && !times.last().isValid()) {
+            // The list is incomplete
+            for (int i = 0;  i < count;  ++i) {
+                if (rule->recursOn(from.addDays(i), timeZone)) {
+                    days.setBit(i);
+                }
+            }
+            continue;
+        }
+        for (const QDateTime &dt : times) {
+            if (dt >= rule->startDt()) {
+                setDay(allDay() ? dt.date() : table->localDate(dt));
+            }
+        }
+    }
+
+    // Exception dates, and days which end before the recurrence starts
+    for (const QDate &date : qAsConst(d->mExDates)) {
+        const qint64 i = from.daysTo(date);
+        if (i >= 0 && i < count) {
+            days.clearBit(i);
+        }
+    }
+    for (int i = 0;  i < count && QDateTime(from.addDays(i), QTime(23, 59, 59), timeZone) < d->mStartDateTime;  ++i) {
+        days.clearBit(i);
+    }
+    return days;
+}
+
 bool Recurrence::recursAt(const QDateTime &dt) const
 {
     // Convert to recurrence's time zone for date comparisons, and for more efficient time comparisons
@@ -204,6 +204,22 @@ public:
     */
     bool recursOn(const QDate &date, const QTimeZone &timeZone) const;
 
+    /**
+      Returns the days of a date range on which the event will recur.
+
+      This gives the same result as calling recursOn() for every day of the
+      range, but expands the recurrence only once.
+
+      @param from first date of the range.
+      @param to last date of the range.
+      @param timeZone time zone for the dates.
+      @return a bit array with one bit per day, starting at @p from. Bits
+              of recurring days are set. An empty array is returned if
+              the range is invalid.
+      @since 5.64
+    */
+    Q_REQUIRED_RESULT QBitArray recurrenceDays(const QDate &from, const QDate &to, const QTimeZone &timeZone) const;
+
     /**
       Returns true if the date/time specified is one at which the event will
       recur. Times are rounded down to the nearest minute to determine the
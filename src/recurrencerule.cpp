@@ -23,7 +23,9 @@
 #include "utils_p.h"
 #include "kcalendarcore_debug.h"
 #include "recurrencehelper_p.h"
+#include "timezonetable_p.h"
 
+#include <QCache>
 #include <QDataStream>
 #include <QStringList>
 #include <QTime>
@@ -34,6 +36,8 @@ using namespace KCalendarCore;
 
 // Maximum number of intervals to process
 const int LOOP_LIMIT = 10000;
+// Number of expanded intervals cached per rule
+const int INTERVAL_CACHE_SIZE = 64;
 
 #ifndef NDEBUG
 static QString dumpTime(const QDateTime &dt, bool allDay);     // for debugging
@@ -47,7 +51,8 @@ static QString dumpTime(const QDateTime &dt, bool allDay);     // for debugging
 = recurrences. For example, if getNextDate() is called repeatedly to      =
 = check all consecutive occurrences over a few years, on a slow machine   =
 = this could take many seconds to complete in the worst case. Simple      =
-= sub-daily recurrences are optimised by use of mTimedRepetition.         =
+= sub-daily recurrences are optimised by use of mTimedRepetition, and     =
+= simple daily, weekly and monthly ones by use of mDayRepetition.         =
 =                                                                         =
 ==========================================================================*/
 
@@ -713,6 +718,7 @@ public:
           mIsReadOnly(false),
           mAllDay(false)
     {
+        mIntervalCache.setMaxCost(INTERVAL_CACHE_SIZE);
         setDirty();
     }
 
@@ -722,11 +728,23 @@ public:
     bool operator==(const Private &other) const;
     void clear();
     void setDirty();
+    void resetCache();
     void buildConstraints();
+    void buildDayRepetition();
     bool buildCache() const;
+    long dayPeriod(const QDate &date) const;
+    QDate dayPeriodStart(long period) const;
+    bool dayMatches(const QDate &date) const;
+    bool dayRecurs(const QDate &date) const;
+    QDate nextRecurringDay(const QDate &date) const;
+    QDate previousRecurringDay(const QDate &date) const;
+    QDateTime dayOccurrence(const QDate &date) const;
+    int recurringDaysTo(const QDate &date) const;
+    int dayOccurrencesTo(const QDateTime &toDate) const;
     Constraint getNextValidDateInterval(const QDateTime &preDate, PeriodType type) const;
     Constraint getPreviousValidDateInterval(const QDateTime &afterDate, PeriodType type) const;
     QList<QDateTime> datesForInterval(const Constraint &interval, PeriodType type) const;
+    QList<QDateTime> expandInterval(const Constraint &interval, PeriodType type) const;
 
     RecurrenceRule *mParent;
     QString mRRule;            // RRULE string
@@ -762,10 +780,27 @@ public:
     mutable QDateTime mCachedLastDate;   // when mCachedDateEnd invalid, last date checked
     mutable bool mCached;
 
+    // Cache of expanded intervals, keyed by period type and start of the interval.
+    // Unlike the duration cache, this one is also used for rules without a count.
+    typedef QPair<int, qint64> IntervalKey;
+    mutable QCache<IntervalKey, QList<QDateTime> > mIntervalCache;
+
     bool mIsReadOnly;
     bool mAllDay;
     bool mNoByRules;        // no BySeconds, ByMinutes, ... rules exist
     uint mTimedRepetition;  // repeats at a regular number of seconds interval, or 0
+
+    enum DayRepetition {
+        NoDayRepetition,
+        DailyRepetition,    // every mFrequency days
+        WeeklyRepetition,   // on the days of mDayMask every mFrequency weeks
+        MonthlyRepetition   // on the days of mMonthDays every mFrequency months
+    };
+    DayRepetition mDayRepetition; // recurs once on days found by simple arithmetic
+    int mDayMask;                 // weekdays of a weekly repetition (bit 0 = Monday)
+    QList<int> mMonthDays;        // sorted days of the month of a monthly repetition
+    TimeZoneTable::Ptr mDayZone;  // transitions of the time zone of mDateStart
+    mutable TimeZoneTable::Ptr mZoneTable;  // last table used, see TimeZoneTable::forTimeZone()
 };
 
 RecurrenceRule::Private::Private(RecurrenceRule *parent, const Private &p)
@@ -792,6 +827,7 @@ RecurrenceRule::Private::Private(RecurrenceRule *parent, const Private &p)
       mAllDay(p.mAllDay),
       mNoByRules(p.mNoByRules)
 {
+    mIntervalCache.setMaxCost(INTERVAL_CACHE_SIZE);
     setDirty();
 }
 
@@ -878,14 +914,20 @@ void RecurrenceRule::Private::clear()
 void RecurrenceRule::Private::setDirty()
 {
     buildConstraints();
-    mCached = false;
-    mCachedDates.clear();
+    resetCache();
     for (int i = 0, iend = mObservers.count();  i < iend;  ++i) {
         if (mObservers[i]) {
             mObservers[i]->recurrenceChanged(mParent);
         }
     }
 }
+
+void RecurrenceRule::Private::resetCache()
+{
+    mCached = false;
+    mCachedDates.clear();
+    mIntervalCache.clear();
+}
 //@endcond
 
 /**************************************************************************
@@ -1328,6 +1370,76 @@ void RecurrenceRule::Private::buildConstraints()
             }
         }
     }
+
+    buildDayRepetition();
+}
+
+// Detect the rules which recur at most once a day, at the time of dtstart,
+// on days which can be found without expanding the constraints.
+void RecurrenceRule::Private::buildDayRepetition()
+{
+    mDayRepetition = NoDayRepetition;
+    mDayMask = 0;
+    mMonthDays.clear();
+    mDayZone.reset();
+    if (!mDateStart.isValid() || mFrequency == 0 ||
+            !mBySetPos.isEmpty() || !mBySeconds.isEmpty() || !mByMinutes.isEmpty() ||
+            !mByHours.isEmpty() || !mByMonths.isEmpty() || !mByYearDays.isEmpty() ||
+            !mByWeekNumbers.isEmpty()) {
+        return;
+    }
+
+    switch (mPeriod) {
+    case rDaily:
+        if (mByDays.isEmpty() && mByMonthDays.isEmpty()) {
+            mDayRepetition = DailyRepetition;
+        }
+        break;
+    case rWeekly:
+        if (!mByMonthDays.isEmpty()) {
+            break;
+        }
+        if (mByDays.isEmpty()) {
+            mDayMask = 1 << (mDateStart.date().dayOfWeek() - 1);
+        }
+        for (const WDayPos &wday : qAsConst(mByDays)) {
+            if (wday.pos() != 0 || wday.day() < 1 || wday.day() > 7) {
+                mDayMask = 0;
+                break;
+            }
+            mDayMask |= 1 << (wday.day() - 1);
+        }
+        if (mDayMask) {
+            mDayRepetition = WeeklyRepetition;
+        }
+        break;
+    case rMonthly:
+        if (!mByDays.isEmpty()) {
+            break;
+        }
+        if (mByMonthDays.isEmpty()) {
+            mMonthDays.append(mDateStart.date().day());
+        }
+        for (int day : qAsConst(mByMonthDays)) {
+            // Days counted from the end of the month are left to the constraints
+            if (day < 1 || day > 31) {
+                mMonthDays.clear();
+                break;
+            }
+            mMonthDays.append(day);
+        }
+        if (!mMonthDays.isEmpty()) {
+            sortAndRemoveDuplicates(mMonthDays);
+            mDayRepetition = MonthlyRepetition;
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (mDayRepetition != NoDayRepetition) {
+        mDayZone = TimeZoneTable::forTimeZone(mDateStart.timeZone());
+    }
 }
 
 // Build and cache a list of all occurrences.
@@ -1376,6 +1488,220 @@ bool RecurrenceRule::Private::buildCache() const
         return false;
     }
 }
+
+// Return the index of the period of a day based repetition which contains a
+// date, counted from the period containing dtstart.
+long RecurrenceRule::Private::dayPeriod(const QDate &date) const
+{
+    const QDate start = mDateStart.date();
+    switch (mDayRepetition) {
+    case DailyRepetition:
+        return start.daysTo(date);
+    case WeeklyRepetition:
+        return dayPeriodStart(0).daysTo(date.addDays(-(7 + date.dayOfWeek() - mWeekStart) % 7)) / 7;
+    case MonthlyRepetition:
+        return 12 * (date.year() - start.year()) + (date.month() - start.month());
+    default:
+        return -1;
+    }
+}
+
+// Return the first day of a period of a day based repetition.
+QDate RecurrenceRule::Private::dayPeriodStart(long period) const
+{
+    const QDate start = mDateStart.date();
+    switch (mDayRepetition) {
+    case DailyRepetition:
+        return start.addDays(period);
+    case WeeklyRepetition:
+        return start.addDays(7 * period - (7 + start.dayOfWeek() - mWeekStart) % 7);
+    case MonthlyRepetition:
+        return QDate(start.year(), start.month(), 1).addMonths(period);
+    default:
+        return QDate();
+    }
+}
+
+// Check whether a date is one of the days selected within its period,
+// regardless of the frequency.
+bool RecurrenceRule::Private::dayMatches(const QDate &date) const
+{
+    switch (mDayRepetition) {
+    case DailyRepetition:
+        return true;
+    case WeeklyRepetition:
+        return mDayMask & (1 << (date.dayOfWeek() - 1));
+    case MonthlyRepetition:
+        return mMonthDays.contains(date.day());
+    default:
+        return false;
+    }
+}
+
+bool RecurrenceRule::Private::dayRecurs(const QDate &date) const
+{
+    const long period = dayPeriod(date);
+    return period >= 0 && period % mFrequency == 0 && dayMatches(date);
+}
+
+// Return the first recurring day on or after a date, ignoring the end of the
+// recurrence.
+QDate RecurrenceRule::Private::nextRecurringDay(const QDate &date) const
+{
+    QDate day = date;
+    for (int loop = 0; loop < LOOP_LIMIT && day.isValid(); ++loop) {
+        const long period = qMax(0L, dayPeriod(day));
+        const long skip = (mFrequency - period % mFrequency) % mFrequency;
+        if (skip || day < dayPeriodStart(period)) {
+            day = dayPeriodStart(period + skip);
+            continue;
+        }
+        if (mDayRepetition == MonthlyRepetition) {
+            const auto it = std::lower_bound(mMonthDays.constBegin(), mMonthDays.constEnd(), day.day());
+            if (it != mMonthDays.constEnd() && *it <= day.daysInMonth()) {
+                return QDate(day.year(), day.month(), *it);
+            }
+        } else {
+            const QDate end = dayPeriodStart(period + 1);
+            for (; day < end; day = day.addDays(1)) {
+                if (dayMatches(day)) {
+                    return day;
+                }
+            }
+        }
+        day = dayPeriodStart(period + mFrequency);
+    }
+    return QDate();
+}
+
+// Return the last recurring day on or before a date. This may be before
+// dtstart if it lies in the first period.
+QDate RecurrenceRule::Private::previousRecurringDay(const QDate &date) const
+{
+    QDate day = date;
+    for (int loop = 0; loop < LOOP_LIMIT && day.isValid(); ++loop) {
+        const long period = dayPeriod(day);
+        if (period < 0) {
+            break;
+        }
+        const long skip = period % mFrequency;
+        if (skip) {
+            day = dayPeriodStart(period - skip + 1).addDays(-1);
+            continue;
+        }
+        if (mDayRepetition == MonthlyRepetition) {
+            auto it = std::upper_bound(mMonthDays.constBegin(), mMonthDays.constEnd(), day.day());
+            if (it != mMonthDays.constBegin()) {
+                --it;
+                return QDate(day.year(), day.month(), *it);
+            }
+        } else {
+            const QDate start = dayPeriodStart(period);
+            for (; day >= start; day = day.addDays(-1)) {
+                if (dayMatches(day)) {
+                    return day;
+                }
+            }
+        }
+        day = dayPeriodStart(period).addDays(-1);
+    }
+    return QDate();
+}
+
+// Return the occurrence on a recurring day. It is invalid if the time of
+// dtstart does not exist on that day.
+QDateTime RecurrenceRule::Private::dayOccurrence(const QDate &date) const
+{
+    const QTime time = mDateStart.time();
+    return mDayZone->dateTime(date, QTime(time.hour(), time.minute(), time.second()));
+}
+
+// Return the number of recurring days from the start of the first period up
+// to and including a date.
+int RecurrenceRule::Private::recurringDaysTo(const QDate &date) const
+{
+    const long period = dayPeriod(date);
+    if (period < 0) {
+        return 0;
+    }
+    // Number of recurring periods before the one containing the date
+    const long periods = (period + mFrequency - 1) / mFrequency;
+    const bool recurringPeriod = !(period % mFrequency);
+    int count = 0;
+    switch (mDayRepetition) {
+    case DailyRepetition:
+        count = periods + (recurringPeriod ? 1 : 0);
+        break;
+    case WeeklyRepetition: {
+        int days = 0;
+        for (int i = 0; i < 7; ++i) {
+            if (mDayMask & (1 << i)) {
+                ++days;
+            }
+        }
+        count = periods * days;
+        if (recurringPeriod) {
+            for (QDate day = dayPeriodStart(period); day <= date; day = day.addDays(1)) {
+                if (dayMatches(day)) {
+                    ++count;
+                }
+            }
+        }
+        break;
+    }
+    case MonthlyRepetition:
+        // Months differ in length, so count them one by one
+        for (long p = 0; p <= period; p += mFrequency) {
+            const int last = (p == period) ? date.day() : dayPeriodStart(p).daysInMonth();
+            for (int day : mMonthDays) {
+                if (day > last) {
+                    break;
+                }
+                ++count;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    return count;
+}
+
+// Return the number of occurrences from dtstart up to and including a date/time.
+int RecurrenceRule::Private::dayOccurrencesTo(const QDateTime &toDate) const
+{
+    QDate first = mDateStart.date();
+    const QDateTime firstDt = dayOccurrence(first);
+    if (firstDt.isValid() && firstDt < mDateStart) {
+        first = first.addDays(1);
+    }
+    QDate last = toDate.date();
+    const QDateTime lastDt = dayOccurrence(last);
+    if (lastDt.isValid() && lastDt > toDate) {
+        last = last.addDays(-1);
+    }
+    if (last < first) {
+        return 0;
+    }
+    int count = recurringDaysTo(last) - recurringDaysTo(first.addDays(-1));
+
+    // Occurrences in the gap of a daylight saving time change don't exist
+    const QTimeZone tz = mDateStart.timeZone();
+    if (tz.hasTransitions()) {
+        const auto transitions = tz.transitions(QDateTime(first.addDays(-1), QTime(0, 0, 0), Qt::UTC),
+                                                QDateTime(last.addDays(2), QTime(0, 0, 0), Qt::UTC));
+        QDate previous;
+        for (const QTimeZone::OffsetData &transition : transitions) {
+            const QDate day = transition.atUtc.toTimeZone(tz).date();
+            if (day != previous && day >= first && day <= last &&
+                    dayRecurs(day) && !dayOccurrence(day).isValid()) {
+                --count;
+            }
+            previous = day;
+        }
+    }
+    return count;
+}
 //@endcond
 
 bool RecurrenceRule::dateMatchesRules(const QDateTime &kdt) const
@@ -1413,6 +1739,11 @@ bool RecurrenceRule::recursOn(const QDate &qd, const QTimeZone &timeZone) const
             }
         }
 
+        if (d->mDayRepetition != Private::NoDayRepetition) {
+            // It's a simple day based recurrence
+            return d->dayRecurs(qd) && d->dayOccurrence(qd).isValid();
+        }
+
         // The date must be in an appropriate interval (getNextValidDateInterval),
         // Plus it must match at least one of the constraints
         bool match = false;
@@ -1476,6 +1807,21 @@ bool RecurrenceRule::recursOn(const QDate &qd, const QTimeZone &timeZone) const
         return start.addSecs(d->mTimedRepetition - n) < end;
     }
 
+    if (d->mDayRepetition != Private::NoDayRepetition) {
+        // It's a simple day based recurrence. Only occurrences before the
+        // start of the next day count, unless end was limited by the recurrence end.
+        const QDateTime dayEnd = QDateTime(qd, QTime(0, 0, 0), timeZone).addDays(1);
+        QDate day = d->nextRecurringDay(start.date());
+        for (int loop = 0; loop < LOOP_LIMIT && day.isValid() && day <= end.date(); ++loop) {
+            const QDateTime dt = d->dayOccurrence(day);
+            if (dt.isValid() && dt >= start) {
+                return dt <= end && dt < dayEnd;
+            }
+            day = d->nextRecurringDay(day.addDays(1));
+        }
+        return false;
+    }
+
     // Find the start and end dates in the time spec for the rule
     QDate startDay = start.date();
     QDate endDay = end.addSecs(-1).date();
@@ -1550,6 +1896,11 @@ bool RecurrenceRule::recursAt(const QDateTime &kdt) const
         return !(d->mDateStart.secsTo(dt) % d->mTimedRepetition);
     }
 
+    if (d->mDayRepetition != Private::NoDayRepetition) {
+        // It's a simple day based recurrence
+        return d->dayRecurs(dt.date()) && d->dayOccurrence(dt.date()) == dt;
+    }
+
     // The date must be in an appropriate interval (getNextValidDateInterval),
     // Plus it must match at least one of the constraints
     if (!dateMatchesRules(dt)) {
@@ -1574,8 +1925,13 @@ TimeList RecurrenceRule::recurTimesOn(const QDate &date, const QTimeZone &timeZo
     QDateTime start(date, QTime(0, 0, 0), timeZone);
     QDateTime end = start.addDays(1).addSecs(-1);
     auto dts = timesInInterval(start, end);     // returns between start and end inclusive
+    if (dts.isEmpty()) {
+        return lst;
+    }
+    const TimeZoneTable::Ptr &table = TimeZoneTable::forTimeZone(timeZone, d->mZoneTable);
+    lst.reserve(dts.count());
     for (int i = 0, iend = dts.count();  i < iend;  ++i) {
-        lst += dts[i].toTimeZone(timeZone).time();
+        lst += table->localTime(dts[i]);
     }
     return lst;
 }
@@ -1600,6 +1956,14 @@ int RecurrenceRule::durationTo(const QDateTime &dt) const
         return static_cast<int>(d->mDateStart.secsTo(toDate) / d->mTimedRepetition);
     }
 
+    if (d->mDayRepetition != Private::NoDayRepetition) {
+        // It's a simple day based recurrence
+        if (d->mDuration == 0 && endDt().isValid() && toDate > endDt()) {
+            toDate = endDt();
+        }
+        return d->dayOccurrencesTo(toDate);
+    }
+
     return timesInInterval(d->mDateStart, toDate).count();
 }
 
@@ -1649,6 +2013,19 @@ QDateTime RecurrenceRule::getPreviousDate(const QDateTime &afterDate) const
         prev = endDt().addSecs(1).toTimeZone(d->mDateStart.timeZone());
     }
 
+    if (d->mDayRepetition != Private::NoDayRepetition) {
+        // It's a simple day based recurrence
+        QDate day = d->previousRecurringDay(prev.date());
+        for (int loop = 0; loop < LOOP_LIMIT && day.isValid(); ++loop) {
+            const QDateTime dt = d->dayOccurrence(day);
+            if (dt.isValid() && dt < prev) {
+                return (dt >= d->mDateStart) ? dt : QDateTime();
+            }
+            day = d->previousRecurringDay(day.addDays(-1));
+        }
+        return QDateTime();
+    }
+
     Constraint interval(d->getPreviousValidDateInterval(prev, recurrenceType()));
     const auto dts = d->datesForInterval(interval, recurrenceType());
     const auto it = strictLowerBound(dts.begin(), dts.end(), prev);
@@ -1706,6 +2083,19 @@ QDateTime RecurrenceRule::getNextDate(const QDateTime &preDate) const
     }
 
     QDateTime end = endDt();
+    if (d->mDayRepetition != Private::NoDayRepetition) {
+        // It's a simple day based recurrence
+        QDate day = d->nextRecurringDay(fromDate.date());
+        for (int loop = 0; loop < LOOP_LIMIT && day.isValid(); ++loop) {
+            const QDateTime dt = d->dayOccurrence(day);
+            if (dt.isValid() && dt > fromDate) {
+                return (d->mDuration < 0 || dt <= end) ? dt : QDateTime();
+            }
+            day = d->nextRecurringDay(day.addDays(1));
+        }
+        return QDateTime();
+    }
+
     Constraint interval(d->getNextValidDateInterval(fromDate, recurrenceType()));
     const auto dts = d->datesForInterval(interval, recurrenceType());
     const auto it = std::upper_bound(dts.begin(), dts.end(), fromDate);
@@ -1815,6 +2205,24 @@ QList<QDateTime> RecurrenceRule::timesInInterval(const QDateTime &dtStart,
         st = d->mCachedLastDate.addSecs(1);
     }
 
+    if (d->mDayRepetition != Private::NoDayRepetition) {
+        // It's a simple day based recurrence
+        QDate day = d->nextRecurringDay(st.date());
+        for (int loop = 0; loop < LOOP_LIMIT && day.isValid(); ++loop) {
+            const QDateTime dt = d->dayOccurrence(day);
+            if (dt.isValid()) {
+                if (dt > enddt) {
+                    break;
+                }
+                if (dt >= st) {
+                    result += dt;
+                }
+            }
+            day = d->nextRecurringDay(day.addDays(1));
+        }
+        return result;
+    }
+
     Constraint interval(d->getNextValidDateInterval(st, recurrenceType()));
     int loop = 0;
     do {
@@ -1989,6 +2397,24 @@ Constraint RecurrenceRule::Private::getNextValidDateInterval(const QDateTime &dt
 
 QList<QDateTime> RecurrenceRule::Private::datesForInterval(const Constraint &interval,
                                                                   PeriodType type) const
+{
+    // Intervals are identified by their start, as a wall clock time so that
+    // the key does not depend on daylight saving shifts.
+    const QDateTime start = interval.intervalDateTime(type);
+    if (!start.isValid()) {
+        return expandInterval(interval, type);
+    }
+    const IntervalKey key(type, start.date().toJulianDay() * 86400 + start.time().msecsSinceStartOfDay() / 1000);
+    if (const QList<QDateTime> *dates = mIntervalCache.object(key)) {
+        return *dates;
+    }
+    const QList<QDateTime> dates = expandInterval(interval, type);
+    mIntervalCache.insert(key, new QList<QDateTime>(dates));
+    return dates;
+}
+
+QList<QDateTime> RecurrenceRule::Private::expandInterval(const Constraint &interval,
+                                                                PeriodType type) const
 {
     /* -) Loop through constraints,
        -) merge interval with each constraint
@@ -2326,6 +2752,8 @@ KCALENDARCORE_EXPORT QDataStream &KCalendarCore::operator>>(QDataStream &in, con
        >> d->mIsReadOnly;
 
     d->mPeriod = static_cast<RecurrenceRule::PeriodType>(period);
+    d->buildDayRepetition();
+    d->resetCache();
 
     return in;
 }
@@ -0,0 +1,411 @@
+/*
+  This file is part of the kcalcore library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with this library; see the file COPYING.LIB.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+/**
+  @file
+  This file is part of the API for handling calendar data and
+  defines the SnapshotFormat class.
+
+  @brief
+  Binary calendar snapshot format.
+*/
+#include "snapshotformat.h"
+#include "event.h"
+#include "exceptions.h"
+#include "icalformat.h"
+#include "journal.h"
+#include "todo.h"
+
+#include "kcalendarcore_debug.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+using namespace KCalendarCore;
+
+static const quint32 SNAPSHOT_MAGIC = 0x4B43534E; // "KCSN"
+static const quint32 SNAPSHOT_VERSION = 1;
+static const QDataStream::Version SNAPSHOT_STREAM_VERSION = QDataStream::Qt_5_11;
+
+// The header holds the magic number, the version and the MD5 sum of the payload
+static const int SNAPSHOT_CHECKSUM_SIZE = 16;
+static const int SNAPSHOT_HEADER_SIZE = 8 + SNAPSHOT_CHECKSUM_SIZE;
+
+//@cond PRIVATE
+class Q_DECL_HIDDEN KCalendarCore::SnapshotFormat::Private
+{
+public:
+    enum ReadStatus {
+        ReadOk,
+        ReadInvalid,
+        ReadStale
+    };
+
+    struct Snapshot {
+        QString productId;
+        CustomProperties properties;
+        Incidence::List incidences;
+    };
+
+    QByteArray writePayload(const Calendar::Ptr &calendar, const QString &notebook, bool deleted) const;
+    static QByteArray header(const QByteArray &payload);
+    ReadStatus read(const QByteArray &data, bool checkSource, Snapshot &snapshot) const;
+    static void insert(const Calendar::Ptr &calendar, const Snapshot &snapshot, bool deleted);
+
+    QString mSourceFileName;
+};
+
+static void sourceStamp(const QString &fileName, qint64 &size, qint64 &modified)
+{
+    const QFileInfo info(fileName);
+    if (fileName.isEmpty() || !info.exists()) {
+        size = -1;
+        modified = -1;
+    } else {
+        size = info.size();
+        modified = info.lastModified().toMSecsSinceEpoch();
+    }
+}
+
+// Whether an incidence of the same type, uid and recurrence ID as the
+// deleted incidence is in the calendar again
+static bool isInCalendar(const Calendar::Ptr &calendar, const Incidence::Ptr &incidence)
+{
+    switch (incidence->type()) {
+    case Incidence::TypeEvent:
+        return !calendar->event(incidence->uid(), incidence->recurrenceId()).isNull();
+    case Incidence::TypeTodo:
+        return !calendar->todo(incidence->uid(), incidence->recurrenceId()).isNull();
+    case Incidence::TypeJournal:
+        return !calendar->journal(incidence->uid(), incidence->recurrenceId()).isNull();
+    default:
+        return false;
+    }
+}
+
+QByteArray SnapshotFormat::Private::writePayload(const Calendar::Ptr &calendar,
+                                                 const QString &notebook, bool deleted) const
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(SNAPSHOT_STREAM_VERSION);
+
+    qint64 size, modified;
+    sourceStamp(mSourceFileName, size, modified);
+    out << size << modified << calendar->productId()
+        << *static_cast<CustomProperties *>(calendar.data());
+
+    Incidence::List incidences;
+    const Incidence::List candidates = deleted
+                                       ? Calendar::mergeIncidenceList(calendar->deletedEvents(),
+                                                                      calendar->deletedTodos(),
+                                                                      calendar->deletedJournals())
+                                       : calendar->rawIncidences();
+    incidences.reserve(candidates.size());
+    for (const Incidence::Ptr &incidence : candidates) {
+        if (deleted && isInCalendar(calendar, incidence)) {
+            // only really deleted ones
+            continue;
+        }
+        if (notebook.isEmpty() ||
+                (!calendar->notebook(incidence).isEmpty() && notebook.endsWith(calendar->notebook(incidence)))) {
+            incidences.append(incidence);
+        }
+    }
+
+    out << static_cast<quint32>(incidences.size());
+    for (const Incidence::Ptr &incidence : qAsConst(incidences)) {
+        out << static_cast<qint32>(incidence->type());
+        out << IncidenceBase::Ptr(incidence);
+    }
+
+    return payload;
+}
+
+QByteArray SnapshotFormat::Private::header(const QByteArray &payload)
+{
+    QByteArray header;
+    QDataStream out(&header, QIODevice::WriteOnly);
+    out << SNAPSHOT_MAGIC << SNAPSHOT_VERSION;
+    header += QCryptographicHash::hash(payload, QCryptographicHash::Md5);
+    return header;
+}
+
+SnapshotFormat::Private::ReadStatus SnapshotFormat::Private::read(const QByteArray &data, bool checkSource,
+                                                                  Snapshot &snapshot) const
+{
+    if (data.size() < SNAPSHOT_HEADER_SIZE) {
+        qCWarning(KCALCORE_LOG) << "Snapshot is truncated";
+        return ReadInvalid;
+    }
+
+    quint32 magic, version;
+    QDataStream header(data);
+    header >> magic >> version;
+    if (magic != SNAPSHOT_MAGIC) {
+        qCWarning(KCALCORE_LOG) << "Invalid magic on snapshot";
+        return ReadInvalid;
+    }
+    if (version != SNAPSHOT_VERSION) {
+        qCDebug(KCALCORE_LOG) << "Snapshot has version" << version << "instead of" << SNAPSHOT_VERSION;
+        return ReadStale;
+    }
+
+    // Not a copy: this refers to the (possibly memory mapped) data
+    const QByteArray payload = QByteArray::fromRawData(data.constData() + SNAPSHOT_HEADER_SIZE,
+                                                       data.size() - SNAPSHOT_HEADER_SIZE);
+    const QByteArray checksum = QByteArray::fromRawData(data.constData() + 8, SNAPSHOT_CHECKSUM_SIZE);
+    if (QCryptographicHash::hash(payload, QCryptographicHash::Md5) != checksum) {
+        qCWarning(KCALCORE_LOG) << "Invalid checksum on snapshot";
+        return ReadInvalid;
+    }
+
+    QDataStream in(payload);
+    in.setVersion(SNAPSHOT_STREAM_VERSION);
+
+    qint64 size, modified;
+    in >> size >> modified;
+    if (checkSource) {
+        qint64 currentSize, currentModified;
+        sourceStamp(mSourceFileName, currentSize, currentModified);
+        if (size != currentSize || modified != currentModified) {
+            qCDebug(KCALCORE_LOG) << "Snapshot is older than" << mSourceFileName;
+            return ReadStale;
+        }
+    }
+
+    quint32 count;
+    in >> snapshot.productId >> snapshot.properties >> count;
+    if (in.status() != QDataStream::Ok) {
+        return ReadInvalid;
+    }
+
+    snapshot.incidences.reserve(count);
+    for (quint32 i = 0; i < count; ++i) {
+        qint32 type;
+        in >> type;
+
+        Incidence::Ptr incidence;
+        switch (type) {
+        case IncidenceBase::TypeEvent:
+            incidence = Event::Ptr(new Event);
+            break;
+        case IncidenceBase::TypeTodo:
+            incidence = Todo::Ptr(new Todo);
+            break;
+        case IncidenceBase::TypeJournal:
+            incidence = Journal::Ptr(new Journal);
+            break;
+        default:
+            qCWarning(KCALCORE_LOG) << "Unexpected incidence type on snapshot:" << type;
+            return ReadInvalid;
+        }
+
+        IncidenceBase::Ptr base = incidence;
+        in >> base;
+        if (in.status() != QDataStream::Ok) {
+            return ReadInvalid;
+        }
+        snapshot.incidences.append(incidence);
+    }
+
+    return ReadOk;
+}
+
+void SnapshotFormat::Private::insert(const Calendar::Ptr &calendar, const Snapshot &snapshot, bool deleted)
+{
+    calendar->setCustomProperties(snapshot.properties.customProperties());
+
+    for (const Incidence::Ptr &incidence : snapshot.incidences) {
+        const Incidence::Ptr old = calendar->incidence(incidence->uid(), incidence->recurrenceId());
+        if (old) {
+            if (deleted) {
+                calendar->deleteIncidence(old);   // move old to deleted
+            } else if (incidence->revision() > old->revision()) {
+                calendar->deleteIncidence(old);   // move old to deleted
+                calendar->addIncidence(incidence);   // and replace it with this one
+            }
+        } else if (deleted) {
+            if (!calendar->deleted(incidence->uid(), incidence->recurrenceId())) {
+                calendar->addIncidence(incidence);   // add this one
+                calendar->deleteIncidence(incidence);   // and move it to deleted
+            }
+        } else {
+            calendar->addIncidence(incidence);   // just add this one
+        }
+    }
+}
+//@endcond
+
+SnapshotFormat::SnapshotFormat()
+    : d(new Private)
+{
+}
+
+SnapshotFormat::~SnapshotFormat()
+{
+    delete d;
+}
+
+void SnapshotFormat::setSourceFileName(const QString &fileName)
+{
+    d->mSourceFileName = fileName;
+}
+
+QString SnapshotFormat::sourceFileName() const
+{
+    return d->mSourceFileName;
+}
+
+bool SnapshotFormat::load(const Calendar::Ptr &calendar, const QString &fileName)
+{
+    qCDebug(KCALCORE_LOG) << fileName;
+
+    clearException();
+
+    const bool hasSource = !d->mSourceFileName.isEmpty();
+    Private::ReadStatus status = Private::ReadInvalid;
+    Private::Snapshot snapshot;
+
+    QFile file(fileName);
+    if (file.open(QIODevice::ReadOnly)) {
+        // Map the snapshot rather than reading it, the incidences copy what they need
+        const qint64 size = file.size();
+        uchar *mapped = size > 0 ? file.map(0, size) : nullptr;
+        if (mapped) {
+            status = d->read(QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), size),
+                             hasSource, snapshot);
+            file.unmap(mapped);
+        } else {
+            status = d->read(file.readAll(), hasSource, snapshot);
+        }
+        file.close();
+    } else if (!hasSource) {
+        qCWarning(KCALCORE_LOG) << "load error" << file.errorString();
+        setException(new Exception(Exception::LoadError));
+        return false;
+    }
+
+    if (status == Private::ReadOk) {
+        Private::insert(calendar, snapshot, false);
+        setLoadedProductId(snapshot.productId);
+        return true;
+    }
+
+    if (!hasSource) {
+        setException(new Exception(status == Private::ReadStale ? Exception::CalVersionUnknown
+                                   : Exception::ParseErrorKcal));
+        return false;
+    }
+
+    // Fall back to the iCalendar source, and bring the snapshot up to date
+    qCDebug(KCALCORE_LOG) << "Loading" << d->mSourceFileName << "instead of snapshot";
+    ICalFormat iCal;
+    if (!iCal.load(calendar, d->mSourceFileName)) {
+        setException(new Exception(iCal.exception() ? iCal.exception()->code() : Exception::LoadError,
+                                   iCal.exception() ? iCal.exception()->arguments() : QStringList()));
+        return false;
+    }
+    setLoadedProductId(iCal.loadedProductId());
+
+    if (!save(calendar, fileName)) {
+        qCWarning(KCALCORE_LOG) << "Could not update snapshot" << fileName;
+        clearException();
+    }
+    return true;
+}
+
+bool SnapshotFormat::save(const Calendar::Ptr &calendar, const QString &fileName)
+{
+    qCDebug(KCALCORE_LOG) << fileName;
+
+    clearException();
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCritical() << "file open error: " << file.errorString() << ";filename=" << fileName;
+        setException(new Exception(Exception::SaveErrorOpenFile,
+                                   QStringList(fileName)));
+
+        return false;
+    }
+
+    const QByteArray payload = d->writePayload(calendar, QString(), false);
+    const QByteArray header = Private::header(payload);
+    if (file.write(header) != header.size() || file.write(payload) != payload.size()) {
+        qCDebug(KCALCORE_LOG) << "file write error:" << file.errorString();
+        file.cancelWriting();
+        setException(new Exception(Exception::SaveErrorSaveFile,
+                                   QStringList(fileName)));
+
+        return false;
+    }
+
+    if (!file.commit()) {
+        qCDebug(KCALCORE_LOG) << "file finalize error:" << file.errorString();
+        setException(new Exception(Exception::SaveErrorSaveFile,
+                                   QStringList(fileName)));
+
+        return false;
+    }
+
+    return true;
+}
+
+bool SnapshotFormat::fromString(const Calendar::Ptr &calendar, const QString &string,
+                                bool deleted, const QString &notebook)
+{
+    return fromRawString(calendar, string.toLatin1(), deleted, notebook);
+}
+
+bool SnapshotFormat::fromRawString(const Calendar::Ptr &calendar, const QByteArray &string,
+                                   bool deleted, const QString &notebook)
+{
+    Q_UNUSED(notebook);
+
+    clearException();
+
+    Private::Snapshot snapshot;
+    const Private::ReadStatus status = d->read(string, false, snapshot);
+    if (status != Private::ReadOk) {
+        setException(new Exception(status == Private::ReadStale ? Exception::CalVersionUnknown
+                                   : Exception::ParseErrorKcal));
+        return false;
+    }
+
+    Private::insert(calendar, snapshot, deleted);
+    setLoadedProductId(snapshot.productId);
+    return true;
+}
+
+QString SnapshotFormat::toString(const Calendar::Ptr &calendar,
+                                 const QString &notebook, bool deleted)
+{
+    const QByteArray payload = d->writePayload(calendar, notebook, deleted);
+    return QString::fromLatin1(Private::header(payload) + payload);
+}
+
+void SnapshotFormat::virtual_hook(int id, void *data)
+{
+    Q_UNUSED(id);
+    Q_UNUSED(data);
+    Q_ASSERT(false);
+}
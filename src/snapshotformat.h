@@ -0,0 +1,150 @@
+/*
+  This file is part of the kcalcore library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with this library; see the file COPYING.LIB.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+/**
+  @file
+  This file is part of the API for handling calendar data and
+  defines the SnapshotFormat class.
+
+  @brief
+  Binary calendar snapshot format.
+*/
+
+#ifndef KCALCORE_SNAPSHOTFORMAT_H
+#define KCALCORE_SNAPSHOTFORMAT_H
+
+#include "kcalendarcore_export.h"
+#include "calformat.h"
+
+namespace KCalendarCore
+{
+
+/**
+  @brief
+  Binary calendar snapshot format.
+
+  This class stores the incidences of a calendar in a compact, versioned and
+  checksummed binary file, using the QDataStream serialization of the
+  incidences. Loading a snapshot needs no parsing of iCalendar text and is
+  therefore much faster than loading the same calendar with ICalFormat.
+
+  Snapshots are meant as a cache of an iCalendar file. When a source file is
+  set, the snapshot records its size and modification time, and load() falls
+  back to reading the source file with ICalFormat whenever the snapshot is
+  missing, damaged or stale. The snapshot is then written anew.
+
+  @code
+  SnapshotFormat format;
+  format.setSourceFileName(QStringLiteral("calendar.ics"));
+  format.load(calendar, QStringLiteral("calendar.ics.snapshot"));
+  @endcode
+
+  The snapshot format is private to this library and may change between
+  releases; a snapshot written by another version is considered stale.
+
+  @since 5.64
+*/
+class KCALENDARCORE_EXPORT SnapshotFormat : public CalFormat
+{
+public:
+    /**
+      Constructs a new snapshot format object.
+    */
+    SnapshotFormat();
+
+    /**
+      Destructor.
+    */
+    ~SnapshotFormat() override;
+
+    /**
+      Sets the iCalendar file that snapshots are a cache of.
+      @param fileName is the name of the iCalendar file.
+      @see sourceFileName()
+    */
+    void setSourceFileName(const QString &fileName);
+
+    /**
+      Returns the iCalendar file that snapshots are a cache of, or an empty
+      string if there is none.
+      @see setSourceFileName()
+    */
+    Q_REQUIRED_RESULT QString sourceFileName() const;
+
+    /**
+      @copydoc
+      CalFormat::load()
+
+      If a source file is set and the snapshot is unusable, the source file
+      is loaded instead and the snapshot is rewritten from @p calendar.
+    */
+    bool load(const Calendar::Ptr &calendar, const QString &fileName) override;
+
+    /**
+      @copydoc
+      CalFormat::save()
+    */
+    bool save(const Calendar::Ptr &calendar, const QString &fileName) override;
+
+    /**
+      @copydoc
+      CalFormat::fromString()
+
+      @note The binary data is expected as Latin-1, as returned by toString().
+      This round trip is lossless, but the string takes twice the memory of
+      the data; use fromRawString() or load() instead where possible.
+    */
+    Q_REQUIRED_RESULT bool fromString(const Calendar::Ptr &calendar, const QString &string,
+                                      bool deleted = false, const QString &notebook = QString()) override;
+
+    /**
+      @copydoc
+      CalFormat::fromRawString()
+    */
+    Q_REQUIRED_RESULT bool fromRawString(const Calendar::Ptr &calendar, const QByteArray &string,
+                                         bool deleted = false, const QString &notebook = QString()) override;
+
+    /**
+      @copydoc
+      CalFormat::toString()
+
+      @note The binary data is returned as Latin-1, so the string is not
+      text and takes twice the memory of the data. It can only be read back
+      with fromString(); use save() to keep a snapshot.
+    */
+    Q_REQUIRED_RESULT QString toString(const Calendar::Ptr &calendar,
+                                       const QString &notebook = QString(), bool deleted = false) override;
+
+protected:
+    /**
+      @copydoc
+      IncidenceBase::virtual_hook()
+    */
+    void virtual_hook(int id, void *data) override;
+
+private:
+    //@cond PRIVATE
+    Q_DISABLE_COPY(SnapshotFormat)
+    class Private;
+    Private *const d;
+    //@endcond
+};
+
+}
+
+#endif
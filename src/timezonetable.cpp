@@ -0,0 +1,245 @@
+/*
+  This file is part of the kcalcore library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with this library; see the file COPYING.LIB.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+#include "timezonetable_p.h"
+
+#include <QHash>
+#include <QReadWriteLock>
+
+#include <algorithm>
+
+using namespace KCalendarCore;
+
+namespace {
+
+const qint64 MSECS_PER_DAY = 86400000;
+const qint64 EPOCH_JULIAN_DAY = 2440588;    // 1970-01-01
+
+// Tables shared by the whole process, keyed by zone id. Zones without
+// transitions may be custom zones whose ids are not unique, so their offset
+// is part of the key. UTC is by far the most common zone and needs no lookup.
+struct TimeZoneTables {
+    TimeZoneTables()
+        : utc(new TimeZoneTable(QTimeZone::utc()))
+    {}
+
+    QReadWriteLock lock;
+    QHash<QByteArray, TimeZoneTable::Ptr> tables;
+    const TimeZoneTable::Ptr utc;
+};
+Q_GLOBAL_STATIC(TimeZoneTables, timeZoneTables)
+
+qint64 floorDiv(qint64 a, qint64 b)
+{
+    return a / b - ((a % b < 0) ? 1 : 0);
+}
+
+}
+
+TimeZoneTable::Ptr TimeZoneTable::forTimeZone(const QTimeZone &timeZone)
+{
+    if (!timeZone.isValid()) {
+        return Ptr(new TimeZoneTable(timeZone));
+    }
+
+    TimeZoneTables *shared = timeZoneTables();
+    QByteArray id = timeZone.id();
+    if (!timeZone.hasTransitions()) {
+        if (timeZone.hasDaylightTime()) {
+            // Cannot be tabulated, see the constructor
+            return Ptr(new TimeZoneTable(timeZone));
+        }
+        const int offset = timeZone.offsetFromUtc(QDateTime::fromMSecsSinceEpoch(0, Qt::UTC));
+        if (offset == 0 && id == shared->utc->timeZone().id()) {
+            return shared->utc;
+        }
+        id += ' ' + QByteArray::number(offset);
+    }
+
+    {
+        QReadLocker locker(&shared->lock);
+        const Ptr table = shared->tables.value(id);
+        if (table) {
+            return table;
+        }
+    }
+    const Ptr table(new TimeZoneTable(timeZone));
+    QWriteLocker locker(&shared->lock);
+    auto it = shared->tables.find(id);
+    if (it == shared->tables.end()) {
+        // Another thread may have been quicker
+        it = shared->tables.insert(id, table);
+    }
+    return it.value();
+}
+
+const TimeZoneTable::Ptr &TimeZoneTable::forTimeZone(const QTimeZone &timeZone, Ptr &cached)
+{
+    if (!cached || !cached->matches(timeZone)) {
+        cached = forTimeZone(timeZone);
+    }
+    return cached;
+}
+
+// Check whether this table may be used for timeZone, which is cheaper than
+// looking the table up.
+bool TimeZoneTable::matches(const QTimeZone &timeZone) const
+{
+    // Zones are compared by id, which is only unique for zones with transitions
+    if (!mUsable || mZone != timeZone) {
+        return false;
+    }
+    if (timeZone.hasTransitions()) {
+        return mZone.hasTransitions();
+    }
+    return !mZone.hasTransitions()
+           && timeZone.offsetFromUtc(QDateTime::fromMSecsSinceEpoch(mFirst, Qt::UTC)) == mOffsets.first();
+}
+
+TimeZoneTable::TimeZoneTable(const QTimeZone &timeZone)
+    : mZone(timeZone)
+{
+    if (!mZone.isValid()) {
+        return;
+    }
+    const QDateTime first(QDate(1900, 1, 1), QTime(0, 0, 0), Qt::UTC);
+    const QDateTime last(QDate(2100, 1, 1), QTime(0, 0, 0), Qt::UTC);
+    mFirst = first.toMSecsSinceEpoch();
+    mLast = last.toMSecsSinceEpoch();
+
+    if (!mZone.hasTransitions()) {
+        // Only a fixed offset can be trusted without the transitions
+        mUsable = !mZone.hasDaylightTime();
+        mOffsets.append(mZone.offsetFromUtc(first));
+        return;
+    }
+
+    int offset = mZone.offsetFromUtc(first);
+    const auto transitions = mZone.transitions(first, last);
+    mTransitions.reserve(transitions.count());
+    mOffsets.reserve(transitions.count() + 1);
+    for (const QTimeZone::OffsetData &transition : transitions) {
+        // Skip changes of the abbreviation or the DST status alone
+        if (transition.offsetFromUtc == offset) {
+            continue;
+        }
+        mTransitions.append(transition.atUtc.toMSecsSinceEpoch());
+        mOffsets.append(offset);
+        offset = transition.offsetFromUtc;
+    }
+    mOffsets.append(offset);
+    mUsable = true;
+}
+
+bool TimeZoneTable::lookup(qint64 utcMSecs, int &offset) const
+{
+    if (!mUsable || utcMSecs < mFirst || utcMSecs >= mLast) {
+        return false;
+    }
+    const auto it = std::upper_bound(mTransitions.cbegin(), mTransitions.cend(), utcMSecs);
+    offset = mOffsets.at(it - mTransitions.cbegin());
+    return true;
+}
+
+int TimeZoneTable::offsetFromUtc(qint64 utcMSecs) const
+{
+    int offset;
+    if (lookup(utcMSecs, offset)) {
+        return offset;
+    }
+    return mZone.offsetFromUtc(QDateTime::fromMSecsSinceEpoch(utcMSecs, Qt::UTC));
+}
+
+qint64 TimeZoneTable::localMSecs(const QDateTime &dt, bool &ok) const
+{
+    int offset = 0;
+    ok = dt.isValid();
+    if (ok) {
+        const qint64 utcMSecs = dt.toMSecsSinceEpoch();
+        ok = lookup(utcMSecs, offset);
+        return utcMSecs + offset * 1000;
+    }
+    return 0;
+}
+
+QDate TimeZoneTable::localDate(const QDateTime &dt) const
+{
+    bool ok;
+    const qint64 msecs = localMSecs(dt, ok);
+    if (!ok) {
+        return dt.toTimeZone(mZone).date();
+    }
+    return QDate::fromJulianDay(floorDiv(msecs, MSECS_PER_DAY) + EPOCH_JULIAN_DAY);
+}
+
+QTime TimeZoneTable::localTime(const QDateTime &dt) const
+{
+    bool ok;
+    const qint64 msecs = localMSecs(dt, ok);
+    if (!ok) {
+        return dt.toTimeZone(mZone).time();
+    }
+    return QTime::fromMSecsSinceStartOfDay(int(msecs - floorDiv(msecs, MSECS_PER_DAY) * MSECS_PER_DAY));
+}
+
+bool TimeZoneTable::localToUtc(qint64 localMSecs, qint64 &utcMSecs) const
+{
+    // UTC offsets stay well below a day, so only the transitions within a
+    // day either side of the local time can affect it
+    if (!mUsable || localMSecs < mFirst + 2 * MSECS_PER_DAY || localMSecs >= mLast - 2 * MSECS_PER_DAY) {
+        return false;
+    }
+    const auto begin = std::lower_bound(mTransitions.cbegin(), mTransitions.cend(),
+                                        localMSecs - MSECS_PER_DAY);
+    const auto end = std::upper_bound(begin, mTransitions.cend(), localMSecs + MSECS_PER_DAY);
+    const int index = begin - mTransitions.cbegin();
+
+    if (begin == end) {
+        utcMSecs = localMSecs - mOffsets.at(index) * 1000;
+        return true;
+    }
+    if (end - begin > 1) {
+        return false;
+    }
+
+    // A single transition: the local time may exist before it, after it,
+    // both (ambiguous) or neither (in the gap)
+    const qint64 before = localMSecs - mOffsets.at(index) * 1000;
+    const qint64 after = localMSecs - mOffsets.at(index + 1) * 1000;
+    const bool validBefore = before < *begin;
+    const bool validAfter = after >= *begin;
+    if (validBefore == validAfter) {
+        return false;
+    }
+    utcMSecs = validBefore ? before : after;
+    return true;
+}
+
+QDateTime TimeZoneTable::dateTime(const QDate &date, const QTime &time) const
+{
+    if (date.isValid() && time.isValid()) {
+        qint64 utcMSecs;
+        const qint64 msecs = (date.toJulianDay() - EPOCH_JULIAN_DAY) * MSECS_PER_DAY
+                             + time.msecsSinceStartOfDay();
+        if (localToUtc(msecs, utcMSecs)) {
+            return QDateTime::fromMSecsSinceEpoch(utcMSecs, mZone);
+        }
+    }
+    return QDateTime(date, time, mZone);
+}
@@ -0,0 +1,119 @@
+/*
+  This file is part of the kcalcore library.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with this library; see the file COPYING.LIB.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+#ifndef KCALCORE_TIMEZONETABLE_P_H
+#define KCALCORE_TIMEZONETABLE_P_H
+
+#include "kcalendarcore_export.h"
+
+#include <QDateTime>
+#include <QSharedPointer>
+#include <QTimeZone>
+#include <QVector>
+
+namespace KCalendarCore {
+
+/**
+  @internal
+
+  A compact table of the UTC offset changes of a time zone.
+
+  The table holds the transitions of the zone between 1900 and 2100 as
+  sorted UTC instants, so that converting between UTC and the wall-clock
+  time of the zone is a binary search instead of a query of the time zone
+  backend. Instants outside that range, zones whose transitions are not
+  known and local times which are ambiguous or fall into a gap are passed
+  on to QTimeZone and QDateTime, so the results always equal those of
+  QDateTime::toTimeZone() and of the QDateTime constructor.
+
+  Tables are immutable and shared; use forTimeZone() to get one.
+*/
+class KCALENDARCORE_EXPORT TimeZoneTable
+{
+public:
+    typedef QSharedPointer<const TimeZoneTable> Ptr;
+
+    /**
+      Returns the table for @p timeZone, building it on first use.
+      This function is thread-safe.
+    */
+    static Ptr forTimeZone(const QTimeZone &timeZone);
+
+    /**
+      Returns the table for @p timeZone like forTimeZone(), but reuses
+      @p cached if it already is the table of that zone, and replaces it
+      otherwise. Use this in loops and repeatedly called functions to save
+      the lookup of the shared table.
+    */
+    static const Ptr &forTimeZone(const QTimeZone &timeZone, Ptr &cached);
+
+    explicit TimeZoneTable(const QTimeZone &timeZone);
+
+    QTimeZone timeZone() const
+    {
+        return mZone;
+    }
+
+    /**
+      Returns the offset from UTC in seconds at the instant @p utcMSecs.
+    */
+    int offsetFromUtc(qint64 utcMSecs) const;
+
+    /**
+      Returns the wall-clock date of @p dt in this time zone, the same as
+      dt.toTimeZone(timeZone()).date().
+    */
+    QDate localDate(const QDateTime &dt) const;
+
+    /**
+      Returns the wall-clock time of @p dt in this time zone, the same as
+      dt.toTimeZone(timeZone()).time().
+    */
+    QTime localTime(const QDateTime &dt) const;
+
+    /**
+      Returns the date/time with wall-clock @p date and @p time in this time
+      zone, the same as QDateTime(date, time, timeZone()).
+    */
+    QDateTime dateTime(const QDate &date, const QTime &time) const;
+
+    /**
+      Converts the wall-clock time @p localMSecs, counted from the epoch
+      as if the zone were UTC, into the instant @p utcMSecs.
+      @return false if the local time is not covered by the table, is
+      ambiguous or does not exist in this time zone.
+    */
+    bool localToUtc(qint64 localMSecs, qint64 &utcMSecs) const;
+
+private:
+    bool matches(const QTimeZone &timeZone) const;
+    bool lookup(qint64 utcMSecs, int &offset) const;
+    qint64 localMSecs(const QDateTime &dt, bool &ok) const;
+
+    QTimeZone mZone;
+    QVector<qint64> mTransitions;   // UTC instants at which the offset changes
+    QVector<int> mOffsets;          // mOffsets[i] applies up to mTransitions[i]
+    qint64 mFirst = 0;              // range covered by the table
+    qint64 mLast = 0;
+    bool mUsable = false;
+};
+
+}
+
+#endif
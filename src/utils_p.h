@@ -24,6 +24,7 @@
 
 #include "kcalendarcore_export.h"
 
+#include <QAtomicInt>
 #include <QDateTime>
 
 class QDataStream;
@@ -42,6 +43,12 @@ void deserializeQDateTimeList(QDataStream &in, QList<QDateTime> &list);
 void serializeQTimeZoneAsSpec(QDataStream &out, const QTimeZone &tz);
 void deserializeSpecAsQTimeZone(QDataStream &in, QTimeZone &tz);
 
+/**
+ * Counts the changes of scheduling IDs, which Incidence::setSchedulingID()
+ * does not announce to the observers of the incidence.
+ */
+extern QAtomicInt schedulingIdChanges;
+
 }
 
 #endif